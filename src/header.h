@@ -63,6 +63,7 @@ const std::string BLINK = "\033[5m";
 // 声明全局变量（不定义）
 extern std::string home_dir;
 extern std::string dir_now;
+// 变量的文本形式，供插件通过 PluginContext::global_vars 访问；shell 内部使用 VariableStore
 extern std::unordered_map<std::string, std::string> shell_global_vars;
 
 // 函数声明
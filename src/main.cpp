@@ -1,5 +1,7 @@
 #include "header.h"
 #include "plugins/plugin_manager.h"
+#include "shell/persistent_vars.h"
+#include "shell/variable_store.h"
 #include "version.h"
 
 int main(int argc, char **argv) {
@@ -75,10 +77,14 @@ int main(int argc, char **argv) {
         }
     }
 
+    // 读入 set -p 保存的变量，插件初始化时即可使用
+    PersistentVars::load();
+
     // 初始化插件系统
     PluginManager::loadPlugins();
     PluginManager::installAllPlugins(); // 扫描并安装所有插件
     PluginManager::buildCommandMap();   // 构建命令映射表
+    VariableStore::sync_from_view();    // 读回插件初始化时设置的变量
 
     if (argc < 2) {
         startup();
@@ -0,0 +1,529 @@
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+
+#include "../header.h"
+#include "arithmetic.h"
+#include "variable_store.h"
+
+namespace {
+
+enum class Op : uint8_t {
+    PushInteger, PushReal, Load,
+    Negate, Not, BitNot, ToBool,
+    Add, Subtract, Multiply, Divide, Modulo, Power,
+    ShiftLeft, ShiftRight, BitAnd, BitXor, BitOr,
+    Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual,
+    Jump, JumpIfFalse, JumpIfTrue, // 条件跳转弹出栈顶
+};
+
+struct Instruction {
+    Op op;
+    union {
+        int64_t integer;
+        double real;
+        VariableStore::Symbol symbol;
+        size_t target; // 跳转目标的指令下标
+    };
+};
+
+using Program = std::vector<Instruction>;
+
+struct Number {
+    int64_t integer = 0;
+    double real = 0;
+    bool is_real = false;
+
+    double as_real() const { return is_real ? real : static_cast<double>(integer); }
+    bool truthy() const { return is_real ? real != 0 : integer != 0; }
+};
+
+Number make_integer(int64_t value) {
+    Number n;
+    n.integer = value;
+    return n;
+}
+
+Number make_real(double value) {
+    Number n;
+    n.real = value;
+    n.is_real = true;
+    return n;
+}
+
+// 二元运算符，按优先级从低到高
+struct BinaryOperator {
+    const char* text;
+    int precedence;
+    Op op;
+};
+
+constexpr BinaryOperator BINARY_OPERATORS[] = {
+    // 较长的写法在前，避免 "**" 被识别为 "*"
+    {"||", 1, Op::JumpIfTrue}, {"&&", 2, Op::JumpIfFalse},
+    {"==", 6, Op::Equal}, {"!=", 6, Op::NotEqual},
+    {"<=", 7, Op::LessEqual}, {">=", 7, Op::GreaterEqual},
+    {"<<", 8, Op::ShiftLeft}, {">>", 8, Op::ShiftRight},
+    {"**", 11, Op::Power},
+    {"|", 3, Op::BitOr}, {"^", 4, Op::BitXor}, {"&", 5, Op::BitAnd},
+    {"<", 7, Op::Less}, {">", 7, Op::Greater},
+    {"+", 9, Op::Add}, {"-", 9, Op::Subtract},
+    {"*", 10, Op::Multiply}, {"/", 10, Op::Divide}, {"%", 10, Op::Modulo},
+};
+
+bool is_name_start(char c) {
+    return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+}
+
+bool is_name_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// 按优先级爬升法解析表达式，边解析边生成指令
+class Compiler {
+public:
+    Compiler(const std::string& source, Program& code) : source(source), code(code) {}
+
+    bool compile(std::string& message) {
+        parse_ternary();
+        skip_space();
+        if (error.empty() && pos < source.size()) fail("unexpected '" + source.substr(pos, 1) + "'");
+        message = error;
+        return error.empty();
+    }
+
+private:
+    void fail(const std::string& message) {
+        if (error.empty()) error = message;
+        pos = source.size();
+    }
+
+    void skip_space() {
+        while (pos < source.size() && std::isspace(static_cast<unsigned char>(source[pos]))) pos++;
+    }
+
+    bool accept(const char* text) {
+        skip_space();
+        size_t length = std::char_traits<char>::length(text);
+        if (source.compare(pos, length, text) != 0) return false;
+        pos += length;
+        return true;
+    }
+
+    size_t emit(Op op) {
+        Instruction instruction{};
+        instruction.op = op;
+        code.push_back(instruction);
+        return code.size() - 1;
+    }
+
+    void patch(size_t jump) {
+        code[jump].target = code.size();
+    }
+
+    void parse_ternary() {
+        parse_binary(1);
+        if (!accept("?")) return;
+        size_t to_else = emit(Op::JumpIfFalse);
+        parse_ternary();
+        size_t to_end = emit(Op::Jump);
+        patch(to_else);
+        if (!accept(":")) return fail("expected ':'");
+        parse_ternary();
+        patch(to_end);
+    }
+
+    const BinaryOperator* peek_operator(int min_precedence) {
+        skip_space();
+        for (const BinaryOperator& candidate : BINARY_OPERATORS) {
+            size_t length = std::char_traits<char>::length(candidate.text);
+            if (source.compare(pos, length, candidate.text) != 0) continue;
+            return candidate.precedence >= min_precedence ? &candidate : nullptr;
+        }
+        return nullptr;
+    }
+
+    void parse_binary(int min_precedence) {
+        parse_unary();
+        while (const BinaryOperator* op = peek_operator(min_precedence)) {
+            pos += std::char_traits<char>::length(op->text);
+            if (op->op == Op::JumpIfFalse || op->op == Op::JumpIfTrue) {
+                // 短路：左边已决定结果时跳过右边，直接得到 0 或 1
+                size_t to_short = emit(op->op);
+                parse_binary(op->precedence + 1);
+                emit(Op::ToBool);
+                size_t to_end = emit(Op::Jump);
+                patch(to_short);
+                code[emit(Op::PushInteger)].integer = op->op == Op::JumpIfTrue ? 1 : 0;
+                patch(to_end);
+                continue;
+            }
+            // ** 右结合，其余左结合
+            parse_binary(op->op == Op::Power ? op->precedence : op->precedence + 1);
+            emit(op->op);
+        }
+    }
+
+    void parse_unary() {
+        if (accept("-")) {
+            parse_unary();
+            emit(Op::Negate);
+        }
+        else if (accept("+")) {
+            parse_unary();
+        }
+        else if (accept("!")) {
+            parse_unary();
+            emit(Op::Not);
+        }
+        else if (accept("~")) {
+            parse_unary();
+            emit(Op::BitNot);
+        }
+        else {
+            parse_primary();
+        }
+    }
+
+    void parse_primary() {
+        skip_space();
+        if (pos >= source.size()) return fail("unexpected end of expression");
+        char c = source[pos];
+        if (c == '(') {
+            pos++;
+            parse_ternary();
+            if (!accept(")")) fail("expected ')'");
+            return;
+        }
+        if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') return parse_number();
+        if (c == '$') {
+            pos++;
+            bool braced = pos < source.size() && source[pos] == '{';
+            if (braced) pos++;
+            parse_name();
+            if (braced && !accept("}")) fail("expected '}'");
+            return;
+        }
+        if (is_name_start(c)) return parse_name();
+        fail("unexpected '" + std::string(1, c) + "'");
+    }
+
+    void parse_name() {
+        size_t start = pos;
+        if (pos >= source.size() || !is_name_start(source[pos])) return fail("expected a variable name");
+        while (pos < source.size() && is_name_char(source[pos])) pos++;
+        std::string_view name(source.data() + start, pos - start);
+        code[emit(Op::Load)].symbol = VariableStore::intern(name);
+    }
+
+    void parse_number() {
+        const char* begin = source.data() + pos;
+        const char* end = source.data() + source.size();
+        if (source.compare(pos, 2, "0x") == 0 || source.compare(pos, 2, "0X") == 0) {
+            int64_t value = 0;
+            auto result = std::from_chars(begin + 2, end, value, 16);
+            if (result.ec != std::errc() || result.ptr == begin + 2) return fail("invalid number");
+            pos = static_cast<size_t>(result.ptr - source.data());
+            code[emit(Op::PushInteger)].integer = value;
+            return;
+        }
+        size_t scan = pos;
+        bool is_real = false;
+        while (scan < source.size() && (std::isdigit(static_cast<unsigned char>(source[scan])) || source[scan] == '.')) {
+            if (source[scan] == '.') is_real = true;
+            scan++;
+        }
+        if (scan < source.size() && (source[scan] == 'e' || source[scan] == 'E')) is_real = true;
+
+        if (is_real) {
+            char* parsed = nullptr;
+            std::string text = source.substr(pos);
+            double value = std::strtod(text.c_str(), &parsed);
+            if (parsed == text.c_str()) return fail("invalid number");
+            pos += static_cast<size_t>(parsed - text.c_str());
+            code[emit(Op::PushReal)].real = value;
+            return;
+        }
+        int64_t value = 0;
+        auto result = std::from_chars(begin, end, value);
+        if (result.ec != std::errc()) return fail("number too large");
+        pos = static_cast<size_t>(result.ptr - source.data());
+        code[emit(Op::PushInteger)].integer = value;
+    }
+
+    const std::string& source;
+    Program& code;
+    size_t pos = 0;
+    std::string error;
+};
+
+// 整数运算按补码回绕，避免有符号溢出
+int64_t wrap(uint64_t value) {
+    return static_cast<int64_t>(value);
+}
+
+int64_t integer_power(int64_t base, int64_t exponent) {
+    uint64_t result = 1;
+    uint64_t factor = static_cast<uint64_t>(base);
+    for (; exponent > 0; exponent >>= 1) {
+        if (exponent & 1) result *= factor;
+        factor *= factor;
+    }
+    return wrap(result);
+}
+
+bool load_variable(VariableStore::Symbol symbol, Number& number, std::string& error) {
+    const Value* value = VariableStore::get(symbol);
+    if (!value) {
+        number = make_integer(0);
+        return true;
+    }
+    int64_t integer = 0;
+    if (value->as_integer(integer)) {
+        number = make_integer(integer);
+        return true;
+    }
+    if (const std::string* text = value->string()) {
+        char* end = nullptr;
+        double real = std::strtod(text->c_str(), &end);
+        if (!text->empty() && *end == '\0') {
+            number = make_real(real);
+            return true;
+        }
+    }
+    error = "variable '" + VariableStore::name(symbol) + "' is not a number";
+    return false;
+}
+
+bool apply_binary(Op op, const Number& a, const Number& b, Number& out, std::string& error) {
+    bool real = a.is_real || b.is_real;
+    switch (op) {
+    case Op::Add:
+        out = real ? make_real(a.as_real() + b.as_real())
+                   : make_integer(wrap(static_cast<uint64_t>(a.integer) + static_cast<uint64_t>(b.integer)));
+        return true;
+    case Op::Subtract:
+        out = real ? make_real(a.as_real() - b.as_real())
+                   : make_integer(wrap(static_cast<uint64_t>(a.integer) - static_cast<uint64_t>(b.integer)));
+        return true;
+    case Op::Multiply:
+        out = real ? make_real(a.as_real() * b.as_real())
+                   : make_integer(wrap(static_cast<uint64_t>(a.integer) * static_cast<uint64_t>(b.integer)));
+        return true;
+    case Op::Divide:
+    case Op::Modulo:
+        if (!b.truthy()) {
+            error = "division by zero";
+            return false;
+        }
+        if (real) {
+            out = make_real(op == Op::Divide ? a.as_real() / b.as_real() : std::fmod(a.as_real(), b.as_real()));
+        }
+        else if (b.integer == -1) {
+            // INT64_MIN / -1 会溢出，按回绕处理
+            out = make_integer(op == Op::Divide ? wrap(0 - static_cast<uint64_t>(a.integer)) : 0);
+        }
+        else {
+            out = make_integer(op == Op::Divide ? a.integer / b.integer : a.integer % b.integer);
+        }
+        return true;
+    case Op::Power:
+        if (real) {
+            out = make_real(std::pow(a.as_real(), b.as_real()));
+            return true;
+        }
+        if (b.integer < 0) {
+            error = "negative exponent";
+            return false;
+        }
+        out = make_integer(integer_power(a.integer, b.integer));
+        return true;
+    case Op::Less:
+        out = make_integer(real ? a.as_real() < b.as_real() : a.integer < b.integer);
+        return true;
+    case Op::LessEqual:
+        out = make_integer(real ? a.as_real() <= b.as_real() : a.integer <= b.integer);
+        return true;
+    case Op::Greater:
+        out = make_integer(real ? a.as_real() > b.as_real() : a.integer > b.integer);
+        return true;
+    case Op::GreaterEqual:
+        out = make_integer(real ? a.as_real() >= b.as_real() : a.integer >= b.integer);
+        return true;
+    case Op::Equal:
+        out = make_integer(real ? a.as_real() == b.as_real() : a.integer == b.integer);
+        return true;
+    case Op::NotEqual:
+        out = make_integer(real ? a.as_real() != b.as_real() : a.integer != b.integer);
+        return true;
+    default:
+        break;
+    }
+
+    // 位运算与移位只对整数有意义
+    if (real) {
+        error = "bitwise operators need integers";
+        return false;
+    }
+    switch (op) {
+    case Op::ShiftLeft:
+        out = make_integer(wrap(static_cast<uint64_t>(a.integer) << (b.integer & 63)));
+        break;
+    case Op::ShiftRight:
+        out = make_integer(a.integer >> (b.integer & 63));
+        break;
+    case Op::BitAnd:
+        out = make_integer(a.integer & b.integer);
+        break;
+    case Op::BitXor:
+        out = make_integer(a.integer ^ b.integer);
+        break;
+    default:
+        out = make_integer(a.integer | b.integer);
+        break;
+    }
+    return true;
+}
+
+bool run(const Program& code, Number& result, std::string& error) {
+    // 栈在多次计算之间复用，不重复分配
+    static std::vector<Number> stack;
+    stack.clear();
+    for (size_t ip = 0; ip < code.size(); ++ip) {
+        const Instruction& instruction = code[ip];
+        switch (instruction.op) {
+        case Op::PushInteger:
+            stack.push_back(make_integer(instruction.integer));
+            break;
+        case Op::PushReal:
+            stack.push_back(make_real(instruction.real));
+            break;
+        case Op::Load: {
+            Number value;
+            if (!load_variable(instruction.symbol, value, error)) return false;
+            stack.push_back(value);
+            break;
+        }
+        case Op::Negate: {
+            Number& top = stack.back();
+            if (top.is_real) top.real = -top.real;
+            else top.integer = wrap(0 - static_cast<uint64_t>(top.integer));
+            break;
+        }
+        case Op::Not:
+            stack.back() = make_integer(!stack.back().truthy());
+            break;
+        case Op::ToBool:
+            stack.back() = make_integer(stack.back().truthy());
+            break;
+        case Op::BitNot:
+            if (stack.back().is_real) {
+                error = "bitwise operators need integers";
+                return false;
+            }
+            stack.back().integer = ~stack.back().integer;
+            break;
+        case Op::Jump:
+            ip = instruction.target - 1;
+            break;
+        case Op::JumpIfFalse:
+        case Op::JumpIfTrue: {
+            bool condition = stack.back().truthy();
+            stack.pop_back();
+            if (condition == (instruction.op == Op::JumpIfTrue)) ip = instruction.target - 1;
+            break;
+        }
+        default: {
+            Number b = stack.back();
+            stack.pop_back();
+            Number& a = stack.back();
+            if (!apply_binary(instruction.op, a, b, a, error)) return false;
+            break;
+        }
+        }
+    }
+    result = stack.back();
+    return true;
+}
+
+// 按源文本缓存编译结果；脚本中的表达式数量有限，超出上限时整体清空
+constexpr size_t MAX_CACHED_PROGRAMS = 1024;
+
+std::unordered_map<std::string, Program>& program_cache() {
+    static std::unordered_map<std::string, Program> cache;
+    return cache;
+}
+
+} // namespace
+
+bool Arithmetic::evaluate(const std::string& expression, std::string& result, std::string& error) {
+    auto& cache = program_cache();
+    auto it = cache.find(expression);
+    if (it == cache.end()) {
+        Program code;
+        if (!Compiler(expression, code).compile(error)) return false;
+        if (cache.size() >= MAX_CACHED_PROGRAMS) cache.clear();
+        it = cache.emplace(expression, std::move(code)).first;
+    }
+
+    Number value;
+    if (!run(it->second, value, error)) return false;
+    result.clear();
+    if (value.is_real) {
+        char digits[32];
+        int length = std::snprintf(digits, sizeof(digits), "%.15g", value.real);
+        result.assign(digits, static_cast<size_t>(length));
+    }
+    else {
+        char digits[24];
+        auto converted = std::to_chars(digits, digits + sizeof(digits), value.integer);
+        result.assign(digits, converted.ptr);
+    }
+    return true;
+}
+
+bool Arithmetic::expand(std::string& text) {
+    size_t start = text.find("$((");
+    if (start == std::string::npos) return true;
+
+    std::string out;
+    std::string value;
+    std::string error;
+    size_t copied = 0;
+    while (start != std::string::npos) {
+        // 与 $(( 配对的 ))：表达式中的括号必须成对
+        size_t close = std::string::npos;
+        size_t depth = 0;
+        for (size_t pos = start + 3; pos < text.size(); ++pos) {
+            if (text[pos] == '(') {
+                depth++;
+            }
+            else if (text[pos] == ')') {
+                if (depth == 0) {
+                    if (pos + 1 < text.size() && text[pos + 1] == ')') close = pos;
+                    break;
+                }
+                depth--;
+            }
+        }
+        if (close == std::string::npos) {
+            println(RED << BOLD << "Arithmetic error: missing '))'" << RESET);
+            return false;
+        }
+        if (!evaluate(text.substr(start + 3, close - start - 3), value, error)) {
+            println(RED << BOLD << "Arithmetic error: " << error << RESET);
+            return false;
+        }
+        out.append(text, copied, start - copied);
+        out += value;
+        copied = close + 2;
+        start = text.find("$((", copied);
+    }
+    out.append(text, copied, std::string::npos);
+    text.swap(out);
+    return true;
+}
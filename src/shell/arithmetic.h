@@ -0,0 +1,24 @@
+#ifndef ARITHMETIC_H
+#define ARITHMETIC_H
+
+#include <string>
+
+/**
+ * @brief 算术展开 $(( ))
+ *
+ * 支持整数与浮点数、C 风格的运算符（含 ** 乘方、?: 与短路的 && ||）和括号。变量可以直接写名字，
+ * 也可以写成 $name 或 ${name}，未设置的变量为 0；只要有一个操作数是浮点数，结果就是浮点数。
+ *
+ * 每个表达式第一次出现时编译为栈式虚拟机的指令序列，按源文本缓存，变量引用编译为 VariableStore 的符号。
+ * 循环中重复计算同一表达式只需一次缓存查找和几条指令，不再重新解析，也不按名字查找变量。
+ */
+class Arithmetic {
+public:
+    // 计算表达式，出错时返回 false，error 为原因
+    static bool evaluate(const std::string& expression, std::string& result, std::string& error);
+
+    // 把 text 中的每个 $(( )) 替换为计算结果，出错时输出错误信息并返回 false
+    static bool expand(std::string& text);
+};
+
+#endif // ARITHMETIC_H
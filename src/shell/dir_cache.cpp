@@ -0,0 +1,313 @@
+#include <cerrno>
+#include <cstdint>
+#include <iomanip>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../header.h"
+#include "dir_cache.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+static constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+                                       IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+#endif
+
+struct CacheNode {
+    std::shared_ptr<const DirListing> listing;
+    bool with_stat = false;
+    size_t bytes = 0;
+    int wd = -1;
+    std::list<std::string>::iterator lru_pos;
+};
+
+// inotify 按 inode 分配 wd：同一目录的不同路径（例如经过符号链接）共用一个监视，按引用计数删除
+struct Watch {
+    std::unordered_set<std::string> paths; // 使用该监视的缓存项
+    int pending = 0;                       // 正在读取目录、尚未决定是否缓存的 get() 调用
+    uint64_t generation = 0;               // 每个事件加一，读取期间有变化时不缓存读到的内容
+};
+
+struct DirCacheState {
+    std::mutex mutex;
+    std::unordered_map<std::string, CacheNode> nodes;
+    std::list<std::string> lru; // 头部为最近使用
+    std::unordered_map<int, Watch> watches;
+
+    size_t memory_limit = 64 * 1024 * 1024;
+    size_t memory_used = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t invalidations = 0;
+    uint64_t evictions = 0;
+
+#ifdef __linux__
+    int inotify_fd = -1;
+    int wake_fd = -1;
+    std::thread watcher;
+
+    DirCacheState() {
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        wake_fd = eventfd(0, EFD_CLOEXEC);
+        if (inotify_fd >= 0 && wake_fd >= 0) {
+            watcher = std::thread([this]() { watch_loop(); });
+        }
+    }
+
+    ~DirCacheState() {
+        if (watcher.joinable()) {
+            uint64_t one = 1;
+            (void)!::write(wake_fd, &one, sizeof(one));
+            watcher.join();
+        }
+        if (inotify_fd >= 0) close(inotify_fd);
+        if (wake_fd >= 0) close(wake_fd);
+    }
+
+    bool enabled() const { return watcher.joinable(); }
+
+    // 后台线程：阻塞等待 inotify 事件，空闲时不占用 CPU
+    void watch_loop() {
+        for (;;) {
+            struct pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            if (fds[1].revents & POLLIN) return;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            drain_events_locked();
+        }
+    }
+
+    // 在持有锁时读取并处理所有排队事件，保证 sync() 返回后不会遗漏已发生的变化
+    void drain_events_locked() {
+        alignas(struct inotify_event) char buffer[16 * 1024];
+        for (;;) {
+            ssize_t n = ::read(inotify_fd, buffer, sizeof(buffer));
+            if (n <= 0) return;
+            for (ssize_t offset = 0; offset < n;) {
+                auto* event = reinterpret_cast<struct inotify_event*>(buffer + offset);
+                offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+                handle_event_locked(event->wd, event->mask);
+            }
+        }
+    }
+
+    void handle_event_locked(int wd, uint32_t mask) {
+        auto it = watches.find(wd);
+        if (it == watches.end()) return;
+        it->second.generation++;
+
+        // 该目录以哪些路径缓存，就全部失效
+        std::vector<std::string> paths(it->second.paths.begin(), it->second.paths.end());
+        for (const auto& path : paths) {
+            auto node = nodes.find(path);
+            if (node != nodes.end()) {
+                erase_node_locked(node);
+                invalidations++;
+            }
+        }
+        // 监视已被内核删除；仍有读取中的 get() 时保留记录，它会因 generation 变化而不缓存
+        it = watches.find(wd);
+        if ((mask & IN_IGNORED) && it != watches.end() && it->second.pending == 0) watches.erase(it);
+    }
+#else
+    bool enabled() const { return false; }
+#endif
+
+    // 没有缓存项、也没有读取中的 get() 使用时删除监视
+    void release_watch_locked(int wd) {
+        auto it = watches.find(wd);
+        if (it == watches.end() || !it->second.paths.empty() || it->second.pending > 0) return;
+#ifdef __linux__
+        inotify_rm_watch(inotify_fd, wd);
+#endif
+        watches.erase(it);
+    }
+
+    void erase_node_locked(std::unordered_map<std::string, CacheNode>::iterator node) {
+        int wd = node->second.wd;
+        auto watch = watches.find(wd);
+        if (watch != watches.end()) watch->second.paths.erase(node->first);
+        memory_used -= node->second.bytes;
+        lru.erase(node->second.lru_pos);
+        nodes.erase(node);
+        release_watch_locked(wd);
+    }
+
+    void evict_locked() {
+        while (memory_used > memory_limit && !lru.empty()) {
+            erase_node_locked(nodes.find(lru.back()));
+            evictions++;
+        }
+    }
+};
+
+static DirCacheState& cache_state() {
+    static DirCacheState state;
+    return state;
+}
+
+static size_t listing_bytes(const std::string& path, const DirListing& listing) {
+    size_t bytes = sizeof(CacheNode) + path.capacity() + listing.capacity() * sizeof(DirEntryInfo);
+    for (const auto& entry : listing) {
+        bytes += entry.name.capacity();
+    }
+    return bytes;
+}
+
+static std::string cache_key(const std::string& path) {
+    size_t end = path.find_last_not_of("/\\");
+    if (end == std::string::npos) return path.empty() ? path : path.substr(0, 1);
+    return path.substr(0, end + 1);
+}
+
+std::shared_ptr<const DirListing> DirCache::get(const std::string& path, bool with_stat) {
+    DirCacheState& state = cache_state();
+    const std::string key = cache_key(path);
+
+    std::unique_lock<std::mutex> lock(state.mutex);
+    auto it = state.nodes.find(key);
+    if (it != state.nodes.end() && (!with_stat || it->second.with_stat)) {
+        state.hits++;
+        state.lru.splice(state.lru.begin(), state.lru, it->second.lru_pos);
+        return it->second.listing;
+    }
+    state.misses++;
+    lock.unlock();
+
+    auto read_uncached = [&]() -> std::shared_ptr<const DirListing> {
+        auto listing = std::make_shared<DirListing>();
+        if (!read_directory(key, with_stat, *listing)) return nullptr;
+        return listing;
+    };
+
+#ifdef __linux__
+    if (!state.enabled()) return read_uncached();
+
+    // 先注册监视再读取目录，读取期间发生的变化会通过 generation 发现。
+    // 目录已被其他路径监视时返回同一个 wd
+    int wd = inotify_add_watch(state.inotify_fd, key.c_str(), WATCH_MASK);
+    if (wd < 0) return read_uncached();
+
+    lock.lock();
+    uint64_t generation = 0;
+    {
+        Watch& watch = state.watches[wd];
+        watch.pending++;
+        generation = watch.generation;
+    }
+    lock.unlock();
+
+    auto listing = read_uncached();
+    size_t bytes = listing ? listing_bytes(key, *listing) : 0;
+
+    lock.lock();
+    if (listing && state.watches[wd].generation == generation && bytes <= state.memory_limit) {
+        auto existing = state.nodes.find(key);
+        if (existing != state.nodes.end()) state.erase_node_locked(existing);
+
+        state.watches[wd].paths.insert(key);
+        state.lru.push_front(key);
+        CacheNode& node = state.nodes[key];
+        node.listing = listing;
+        node.with_stat = with_stat;
+        node.bytes = bytes;
+        node.wd = wd;
+        node.lru_pos = state.lru.begin();
+        state.memory_used += bytes;
+        state.evict_locked();
+    }
+    // 替换旧缓存项时 pending 保证监视不被提前删除；没有缓存读到的内容时不保留监视
+    state.watches[wd].pending--;
+    state.release_watch_locked(wd);
+    return listing;
+#else
+    return read_uncached();
+#endif
+}
+
+void DirCache::sync() {
+#ifdef __linux__
+    DirCacheState& state = cache_state();
+    if (!state.enabled()) return;
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.drain_events_locked();
+#endif
+}
+
+void DirCache::set_memory_limit(size_t bytes) {
+    DirCacheState& state = cache_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.memory_limit = bytes;
+    state.evict_locked();
+}
+
+void DirCache::clear() {
+    DirCacheState& state = cache_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    while (!state.lru.empty()) {
+        state.erase_node_locked(state.nodes.find(state.lru.back()));
+    }
+}
+
+void DirCache::print_stats() {
+    DirCacheState& state = cache_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    const double mib = 1024.0 * 1024.0;
+    uint64_t lookups = state.hits + state.misses;
+    double hit_rate = lookups > 0 ? 100.0 * static_cast<double>(state.hits) / static_cast<double>(lookups) : 0.0;
+
+    std::cout << std::fixed << std::setprecision(1);
+    println("Directory cache" << (state.enabled() ? "" : " (disabled: inotify not available)") << ":");
+    println("  Entries:        " << state.nodes.size());
+    println("  Memory:         " << state.memory_used / mib << " MiB / " << state.memory_limit / mib << " MiB");
+    println("  Lookups:        " << lookups << " (hits " << state.hits << ", misses " << state.misses << ")");
+    println("  Hit rate:       " << hit_rate << "%");
+    println("  Invalidations:  " << state.invalidations);
+    println("  Evictions:      " << state.evictions);
+    std::cout << std::defaultfloat;
+}
+
+int builtin_cache(const std::vector<std::string>& cmd) {
+    if (cmd.size() >= 2 && cmd[1] == "stats") {
+        DirCache::print_stats();
+        return 0;
+    }
+    if (cmd.size() >= 2 && cmd[1] == "clear") {
+        DirCache::clear();
+        println(GREEN << "Directory cache cleared." << RESET);
+        return 0;
+    }
+    if (cmd.size() >= 3 && cmd[1] == "limit") {
+        try {
+            unsigned long mib = std::stoul(cmd[2]);
+            DirCache::set_memory_limit(static_cast<size_t>(mib) * 1024 * 1024);
+            println(GREEN << "Directory cache limit set to " << mib << " MiB." << RESET);
+            return 0;
+        } catch (const std::exception&) {
+            println(RED << BOLD << "Invalid size: " << cmd[2] << RESET);
+            return 1;
+        }
+    }
+
+    println("Usage: cache <command>\n"
+            "Commands:\n"
+            "    stats          Show directory cache statistics and hit rate.\n"
+            "    clear          Drop all cached directory listings.\n"
+            "    limit <MiB>    Set the memory cap of the directory cache.");
+    return 1;
+}
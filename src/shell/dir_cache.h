@@ -0,0 +1,43 @@
+#ifndef DIR_CACHE_H
+#define DIR_CACHE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "shell_listing.h"
+
+using DirListing = std::vector<DirEntryInfo>;
+
+/**
+ * @brief 目录内容的 LRU 缓存，供 ls、通配符和补全重复使用
+ *
+ * Linux 下每个缓存目录都注册一个 inotify 监视，由后台线程在目录变化时使缓存失效，
+ * 因此命中时不需要任何系统调用。其他平台上缓存不生效，每次都直接读取目录。
+ */
+class DirCache {
+public:
+    /**
+     * @brief 获取目录内容
+     * @param path 目录绝对路径
+     * @param with_stat 是否需要每项的 stat 信息
+     * @return 目录无法读取时返回 nullptr（保留 errno）
+     */
+    static std::shared_ptr<const DirListing> get(const std::string& path, bool with_stat);
+
+    /**
+     * @brief 立即处理已排队的 inotify 事件
+     *
+     * 后台线程处理事件存在微小延迟；命令执行完毕后调用一次，
+     * 保证该命令造成的修改在下一次查询时已经生效。
+     */
+    static void sync();
+
+    static void set_memory_limit(size_t bytes);
+    static void clear();
+    static void print_stats();
+};
+
+int builtin_cache(const std::vector<std::string>& cmd);
+
+#endif // DIR_CACHE_H
@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <unordered_map>
+
+#include "../header.h"
+#include "frecency_db.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char FILE_MAGIC[8] = {'D', 'S', 'F', 'R', 'C', '0', '1', '\n'};
+constexpr uint16_t FLAG_FORGET = 1;
+
+// 记录头后紧跟 path_length 字节的路径，整条记录按 8 字节对齐
+struct RecordHeader {
+    uint16_t path_length;
+    uint16_t flags;
+    uint32_t visits;
+    int64_t timestamp;
+};
+static_assert(sizeof(RecordHeader) == 16, "RecordHeader must stay 16 bytes on disk");
+
+constexpr size_t record_size(size_t path_length) {
+    return (sizeof(RecordHeader) + path_length + 7) & ~static_cast<size_t>(7);
+}
+
+// 总访问次数超过该值时压缩会整体衰减，长期不用的目录会逐渐被淘汰
+constexpr double MAX_TOTAL_VISITS = 10000;
+
+#ifndef _WIN32
+void lock_file(int fd, int operation) {
+    while (flock(fd, operation) != 0 && errno == EINTR) {}
+}
+
+// 打开并锁住文件。加锁期间文件可能已被其他会话压缩替换，这时重新打开新的文件
+int open_locked(const std::string& path, int flags, int operation) {
+    for (int attempt = 0; attempt < 8; ++attempt) {
+        int fd = open(path.c_str(), flags | O_CLOEXEC);
+        if (fd < 0) return -1;
+        lock_file(fd, operation);
+        struct stat opened{};
+        struct stat current{};
+        if (fstat(fd, &opened) == 0 && stat(path.c_str(), &current) == 0 && opened.st_ino == current.st_ino) return fd;
+        close(fd);
+    }
+    return -1;
+}
+#endif
+
+struct Entry {
+    std::string path;
+    double visits = 0;
+    int64_t last_visit = 0;
+};
+
+struct FrecencyState {
+    std::string file_path;
+    bool loaded = false;
+    uint64_t loaded_bytes = 0; // 已折叠进索引的文件长度
+    size_t record_count = 0;
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, size_t> index;
+#ifndef _WIN32
+    ino_t file_inode = 0;
+#endif
+
+    void reset() {
+        loaded_bytes = 0;
+        record_count = 0;
+        entries.clear();
+        index.clear();
+    }
+
+    void apply(const RecordHeader& header, const char* path) {
+        std::string key(path, header.path_length);
+        auto it = index.find(key);
+
+        if (header.flags & FLAG_FORGET) {
+            if (it == index.end()) return;
+            size_t slot = it->second;
+            index.erase(it);
+            if (slot != entries.size() - 1) {
+                entries[slot] = std::move(entries.back());
+                index[entries[slot].path] = slot;
+            }
+            entries.pop_back();
+            return;
+        }
+
+        if (it == index.end()) {
+            it = index.emplace(key, entries.size()).first;
+            entries.push_back(Entry{std::move(key), 0, 0});
+        }
+        Entry& entry = entries[it->second];
+        entry.visits += header.visits;
+        entry.last_visit = std::max(entry.last_visit, header.timestamp);
+    }
+
+    // 解析 [begin, end) 内的完整记录，返回消耗的字节数；末尾的残缺记录留到下次
+    size_t fold(const char* begin, const char* end) {
+        const char* pos = begin;
+        while (static_cast<size_t>(end - pos) >= sizeof(RecordHeader)) {
+            RecordHeader header{};
+            std::memcpy(&header, pos, sizeof(header));
+            size_t length = record_size(header.path_length);
+            if (static_cast<size_t>(end - pos) < length) break;
+            apply(header, pos + sizeof(RecordHeader));
+            record_count++;
+            pos += length;
+        }
+        return static_cast<size_t>(pos - begin);
+    }
+
+    // 读取其他会话（或本会话）追加的新记录
+    void refresh() {
+        if (file_path.empty()) file_path = home_dir + "/duckshell/dirs.db";
+
+#ifdef _WIN32
+        std::ifstream in(file_path, std::ios::binary);
+        if (!in) {
+            loaded = true;
+            return;
+        }
+        std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        uint64_t size = data.size();
+        if (size < loaded_bytes) reset();
+        const char* base = data.data();
+#else
+        int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            loaded = true;
+            return;
+        }
+        struct stat info{};
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            loaded = true;
+            return;
+        }
+        // 其他会话压缩后文件被整体替换，需要从头重新加载
+        if (info.st_ino != file_inode || static_cast<uint64_t>(info.st_size) < loaded_bytes) reset();
+        file_inode = info.st_ino;
+        if (static_cast<uint64_t>(info.st_size) <= loaded_bytes) {
+            close(fd);
+            loaded = true;
+            return;
+        }
+        uint64_t size = static_cast<uint64_t>(info.st_size);
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            loaded = true;
+            return;
+        }
+        const char* base = static_cast<const char*>(mapping);
+#endif
+
+        if (loaded_bytes == 0 && size >= sizeof(FILE_MAGIC)) {
+            if (std::memcmp(base, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0) loaded_bytes = sizeof(FILE_MAGIC);
+            else loaded_bytes = size; // 不认识的格式：忽略旧内容，下次压缩时覆盖
+        }
+        if (loaded_bytes < size) {
+            loaded_bytes += fold(base + loaded_bytes, base + size);
+        }
+
+#ifndef _WIN32
+        munmap(mapping, size);
+#endif
+        loaded = true;
+    }
+
+    void ensure_loaded() {
+        if (!loaded) refresh();
+    }
+
+    // 文件不存在时写入文件头；O_EXCL 避免两个会话同时创建时重复写入
+    void create_file() {
+#ifdef _WIN32
+        if (!std::ifstream(file_path)) {
+            std::ofstream out(file_path, std::ios::binary);
+            out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+        }
+#else
+        int fd = open(file_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd >= 0) {
+            (void)!::write(fd, FILE_MAGIC, sizeof(FILE_MAGIC));
+            close(fd);
+        }
+#endif
+        refresh();
+    }
+
+    void append(const std::string& path, uint16_t flags) {
+        if (path.size() > UINT16_MAX) return;
+
+        RecordHeader header{};
+        header.path_length = static_cast<uint16_t>(path.size());
+        header.flags = flags;
+        header.visits = 1;
+        header.timestamp = static_cast<int64_t>(std::time(nullptr));
+
+        std::string record(record_size(path.size()), '\0');
+        std::memcpy(&record[0], &header, sizeof(header));
+        std::memcpy(&record[sizeof(header)], path.data(), path.size());
+
+        if (loaded_bytes == 0) create_file();
+
+        // 一次 write 写入整条记录，O_APPEND 保证并发会话的记录不会交错
+#ifdef _WIN32
+        std::ofstream out(file_path, std::ios::binary | std::ios::app);
+        if (!out) return;
+        out.write(record.data(), static_cast<std::streamsize>(record.size()));
+        if (!out) return;
+#else
+        // 共享锁只与压缩时的排他锁互斥，不会写进已被替换掉的旧文件
+        int fd = open_locked(file_path, O_WRONLY | O_APPEND, LOCK_SH);
+        if (fd < 0) return;
+        ssize_t written = ::write(fd, record.data(), record.size());
+        lock_file(fd, LOCK_UN);
+        close(fd);
+        if (written != static_cast<ssize_t>(record.size())) return;
+#endif
+        // 同时读入其他会话在此之前追加的记录
+        refresh();
+    }
+
+    bool needs_compaction() const {
+        return record_count >= 1024 && record_count >= entries.size() * 4;
+    }
+
+    // 记录数远多于目录数时，把每个目录折叠成一条记录重写文件
+    void compact_if_needed() {
+        if (!needs_compaction()) return;
+#ifdef _WIN32
+        write_compacted(file_path + ".tmp");
+#else
+        // 排他锁内重新读入加锁前其他会话追加的记录再判断，文件可能已经被其他会话压缩过
+        int fd = open_locked(file_path, O_RDONLY, LOCK_EX);
+        if (fd < 0) return;
+        refresh();
+        if (needs_compaction()) write_compacted(file_path + ".tmp." + std::to_string(getpid()));
+        lock_file(fd, LOCK_UN);
+        close(fd);
+#endif
+    }
+
+    void write_compacted(const std::string& temp_path) {
+        double total = 0;
+        for (const auto& entry : entries) total += entry.visits;
+        double decay = total > MAX_TOTAL_VISITS ? 0.9 * MAX_TOTAL_VISITS / total : 1.0;
+
+        std::string data(FILE_MAGIC, sizeof(FILE_MAGIC));
+        std::vector<Entry> kept;
+        for (const auto& entry : entries) {
+            double visits = entry.visits * decay;
+            if (visits < 1 || entry.path.size() > UINT16_MAX) continue;
+
+            RecordHeader header{};
+            header.path_length = static_cast<uint16_t>(entry.path.size());
+            header.visits = static_cast<uint32_t>(visits);
+            header.timestamp = entry.last_visit;
+
+            std::string record(record_size(entry.path.size()), '\0');
+            std::memcpy(&record[0], &header, sizeof(header));
+            std::memcpy(&record[sizeof(header)], entry.path.data(), entry.path.size());
+            data += record;
+
+            kept.push_back(Entry{entry.path, static_cast<double>(header.visits), entry.last_visit});
+        }
+
+        // 先写临时文件再 rename，中途失败时原文件保持完整
+        {
+            std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+            if (!out) return;
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!out) return;
+        }
+#ifdef _WIN32
+        std::remove(file_path.c_str());
+#endif
+        if (std::rename(temp_path.c_str(), file_path.c_str()) != 0) {
+            std::remove(temp_path.c_str());
+            return;
+        }
+
+        entries = std::move(kept);
+        index.clear();
+        for (size_t i = 0; i < entries.size(); ++i) index[entries[i].path] = i;
+        record_count = entries.size();
+        loaded_bytes = data.size();
+#ifndef _WIN32
+        struct stat info{};
+        if (stat(file_path.c_str(), &info) == 0) file_inode = info.st_ino;
+#endif
+    }
+};
+
+FrecencyState& frecency_state() {
+    static FrecencyState state;
+    return state;
+}
+
+// 与 z 相同的时间加权：最近一小时 x4，一天内 x2，一周内 x0.5，更早 x0.25
+double frecency_score(const Entry& entry, int64_t now) {
+    int64_t age = now - entry.last_visit;
+    if (age < 3600) return entry.visits * 4;
+    if (age < 86400) return entry.visits * 2;
+    if (age < 604800) return entry.visits / 2;
+    return entry.visits / 4;
+}
+
+// 在 text 的 [from, text.size()) 中查找 needle，返回匹配结束位置，找不到返回 npos
+size_t find_fragment(const std::string& text, const std::string& needle, size_t from, bool ignore_case) {
+    if (!ignore_case) {
+        size_t pos = text.find(needle, from);
+        return pos == std::string::npos ? pos : pos + needle.size();
+    }
+    auto it = std::search(text.begin() + static_cast<std::ptrdiff_t>(from), text.end(), needle.begin(), needle.end(),
+                          [](char a, char b) {
+                              return std::tolower(static_cast<unsigned char>(a)) == b;
+                          });
+    if (it == text.end()) return std::string::npos;
+    return static_cast<size_t>(it - text.begin()) + needle.size();
+}
+
+bool matches(const std::string& path, const std::vector<std::string>& fragments, bool ignore_case) {
+    size_t pos = 0;
+    for (const auto& fragment : fragments) {
+        pos = find_fragment(path, fragment, pos, ignore_case);
+        if (pos == std::string::npos) return false;
+    }
+    // 最后一个片段必须落在最后一段目录名里
+    size_t last_sep = path.find_last_of("/\\");
+    size_t name_start = last_sep == std::string::npos ? 0 : last_sep + 1;
+    return pos > name_start;
+}
+
+} // namespace
+
+void FrecencyDb::record_visit(const std::string& path) {
+    FrecencyState& state = frecency_state();
+    state.ensure_loaded();
+    state.append(path, 0);
+    state.compact_if_needed();
+}
+
+std::vector<FrecencyDb::Match> FrecencyDb::query(const std::vector<std::string>& fragments) {
+    FrecencyState& state = frecency_state();
+    state.refresh();
+
+    // smartcase：片段全为小写时不区分大小写
+    bool ignore_case = true;
+    for (const auto& fragment : fragments) {
+        for (char c : fragment) {
+            if (std::isupper(static_cast<unsigned char>(c))) ignore_case = false;
+        }
+    }
+
+    int64_t now = static_cast<int64_t>(std::time(nullptr));
+    std::vector<Match> result;
+    for (const auto& entry : state.entries) {
+        if (!fragments.empty() && !matches(entry.path, fragments, ignore_case)) continue;
+        result.push_back(Match{entry.path, frecency_score(entry, now)});
+    }
+    std::sort(result.begin(), result.end(), [](const Match& a, const Match& b) {
+        return a.score != b.score ? a.score > b.score : a.path < b.path;
+    });
+    return result;
+}
+
+void FrecencyDb::forget(const std::string& path) {
+    FrecencyState& state = frecency_state();
+    state.ensure_loaded();
+    state.append(path, FLAG_FORGET);
+}
@@ -0,0 +1,37 @@
+#ifndef FRECENCY_DB_H
+#define FRECENCY_DB_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 目录访问频率数据库（frecency = frequency + recency）
+ *
+ * 数据保存在 ~/duckshell/dirs.db，格式为只追加的定长头记录：
+ * 每次访问只 write 一条记录，多个会话可以同时追加。启动时文件被 mmap，
+ * 一次扫描聚合成内存索引；记录数远多于目录数时会重写文件进行压缩。
+ */
+class FrecencyDb {
+public:
+    struct Match {
+        std::string path;
+        double score = 0;
+    };
+
+    // 记录一次对目录的访问
+    static void record_visit(const std::string& path);
+
+    /**
+     * @brief 按片段查找目录
+     *
+     * 所有片段须按顺序出现在路径中，最后一个片段须出现在最后一段目录名中；
+     * 片段全为小写时不区分大小写。结果按得分从高到低排列。
+     */
+    static std::vector<Match> query(const std::vector<std::string>& fragments);
+
+    // 从数据库中删除一个目录（例如目录已不存在）
+    static void forget(const std::string& path);
+};
+
+#endif // FRECENCY_DB_H
@@ -0,0 +1,709 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "../header.h"
+#include "history_log.h"
+#include "history_trie.h"
+#include "trigram_index.h"
+#include "variable_store.h"
+
+#ifdef _WIN32
+#include <mutex>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char FILE_MAGIC[8] = {'D', 'S', 'H', 'I', 'S', 'T', '1', '\n'};
+constexpr uint32_t RECORD_TAG = 0x31485344; // "DSH1"
+
+// 记录由 RecordHeader、命令文本和 RecordTrailer 组成；尾部重复一次长度，可以从文件末尾向前逐条定位
+struct RecordHeader {
+    uint32_t tag;
+    uint32_t length;
+    int64_t timestamp;
+    int32_t exit_code;
+    uint32_t duration_ms;
+};
+static_assert(sizeof(RecordHeader) == 24, "RecordHeader must stay 24 bytes on disk");
+
+struct RecordTrailer {
+    uint32_t length;
+    uint32_t tag;
+};
+static_assert(sizeof(RecordTrailer) == 8, "RecordTrailer must stay 8 bytes on disk");
+
+constexpr uint64_t RECORD_OVERHEAD = sizeof(RecordHeader) + sizeof(RecordTrailer);
+constexpr uint32_t MAX_COMMAND_LENGTH = 1 << 20;
+constexpr size_t DEFAULT_CAPACITY = 100000;
+constexpr size_t MIN_CAPACITY = 100;
+
+// 超出上限的条数达到上限的 1/4 才压缩，避免每追加一条就重写一次文件
+size_t compaction_slack(size_t capacity) {
+    return capacity / 4 + 1;
+}
+
+// offset 处是否为一条完整的记录，是则通过 end 返回记录结束位置
+bool record_at(const char* base, uint64_t size, uint64_t offset, uint64_t& end) {
+    if (offset < sizeof(FILE_MAGIC) || offset > size || size - offset < RECORD_OVERHEAD) return false;
+    RecordHeader header{};
+    std::memcpy(&header, base + offset, sizeof(header));
+    if (header.tag != RECORD_TAG || header.length > MAX_COMMAND_LENGTH) return false;
+    if (size - offset - RECORD_OVERHEAD < header.length) return false;
+    RecordTrailer trailer{};
+    std::memcpy(&trailer, base + offset + sizeof(header) + header.length, sizeof(trailer));
+    if (trailer.tag != RECORD_TAG || trailer.length != header.length) return false;
+    end = offset + RECORD_OVERHEAD + header.length;
+    return true;
+}
+
+// 结束于 end 的那条记录的起始位置
+bool record_before(const char* base, uint64_t end, uint64_t& offset) {
+    if (end < sizeof(FILE_MAGIC) + RECORD_OVERHEAD) return false;
+    RecordTrailer trailer{};
+    std::memcpy(&trailer, base + end - sizeof(trailer), sizeof(trailer));
+    if (trailer.tag != RECORD_TAG || trailer.length > end - sizeof(FILE_MAGIC) - RECORD_OVERHEAD) return false;
+    uint64_t start = end - RECORD_OVERHEAD - trailer.length;
+    uint64_t record_end = 0;
+    if (!record_at(base, end, start, record_end) || record_end != end) return false;
+    offset = start;
+    return true;
+}
+
+/**
+ * 顺序解析 [begin, end) 中的记录，把起始位置追加到 offsets。
+ * 残缺的记录（例如写入中途崩溃）逐字节跳过直到重新对齐；末尾尚未写完的记录留到下次，
+ * 返回值为解析停止的位置。
+ */
+uint64_t scan_records(const char* base, uint64_t begin, uint64_t end, std::vector<uint64_t>& offsets) {
+    uint64_t pos = begin;
+    while (end - pos >= RECORD_OVERHEAD) {
+        uint64_t next = 0;
+        if (record_at(base, end, pos, next)) {
+            offsets.push_back(pos);
+            pos = next;
+            continue;
+        }
+        RecordHeader header{};
+        std::memcpy(&header, base + pos, sizeof(header));
+        if (header.tag == RECORD_TAG && header.length <= MAX_COMMAND_LENGTH &&
+            end - pos < RECORD_OVERHEAD + header.length) {
+            break;
+        }
+        pos++;
+    }
+    return pos;
+}
+
+std::string encode_record(const HistoryLog::Entry& entry) {
+    RecordHeader header{};
+    header.tag = RECORD_TAG;
+    header.length = static_cast<uint32_t>(entry.command.size());
+    header.timestamp = entry.timestamp;
+    header.exit_code = entry.exit_code;
+    header.duration_ms = entry.duration_ms;
+    RecordTrailer trailer{header.length, RECORD_TAG};
+
+    std::string record(RECORD_OVERHEAD + entry.command.size(), '\0');
+    std::memcpy(&record[0], &header, sizeof(header));
+    std::memcpy(&record[sizeof(header)], entry.command.data(), entry.command.size());
+    std::memcpy(&record[sizeof(header) + entry.command.size()], &trailer, sizeof(trailer));
+    return record;
+}
+
+// 为 [begin, end) 中的记录建立自动提示的前缀树，在后台线程中执行，cancel 置位时提前结束
+void build_suggestions(const char* base, uint64_t end, HistoryTrie& trie, const std::atomic<bool>& cancel) {
+    std::vector<uint64_t> offsets;
+    scan_records(base, sizeof(FILE_MAGIC), end, offsets);
+    uint64_t record_end = 0;
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        if (i % 4096 == 0 && cancel) return;
+        if (record_at(base, end, offsets[i], record_end)) {
+            trie.insert(base, offsets[i] + sizeof(RecordHeader),
+                        static_cast<uint32_t>(record_end - offsets[i] - RECORD_OVERHEAD), offsets[i]);
+        }
+    }
+}
+
+// 记录中的命令文本，直接指向映射的文件
+std::string_view record_text(const char* base, uint64_t offset, uint64_t end) {
+    return std::string_view(base + offset + sizeof(RecordHeader), end - offset - RECORD_OVERHEAD);
+}
+
+bool decode_record(const char* base, uint64_t size, uint64_t offset, HistoryLog::Entry& entry) {
+    uint64_t end = 0;
+    if (!record_at(base, size, offset, end)) return false;
+    RecordHeader header{};
+    std::memcpy(&header, base + offset, sizeof(header));
+    entry.command.assign(base + offset + sizeof(header), header.length);
+    entry.timestamp = header.timestamp;
+    entry.exit_code = header.exit_code;
+    entry.duration_ms = header.duration_ms;
+    return true;
+}
+
+#ifdef _WIN32
+// Windows 下没有 flock：进程内的追加与压缩互斥
+std::mutex file_mutex;
+
+bool read_file(const std::string& path, std::string& data) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// 只保留最新的 capacity 条记录，在后台线程中执行
+void compact_file(const std::string& path, size_t capacity) {
+    std::lock_guard<std::mutex> lock(file_mutex);
+    std::string data;
+    if (!read_file(path, data) || data.size() < sizeof(FILE_MAGIC)) return;
+
+    std::vector<uint64_t> offsets;
+    scan_records(data.data(), sizeof(FILE_MAGIC), data.size(), offsets);
+    if (offsets.size() <= capacity + compaction_slack(capacity)) return;
+    uint64_t keep_from = offsets[offsets.size() - capacity];
+
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) return;
+        out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+        out.write(data.data() + keep_from, static_cast<std::streamsize>(data.size() - keep_from));
+        if (!out) return;
+    }
+    std::remove(path.c_str());
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) std::remove(temp_path.c_str());
+}
+#else
+bool write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = ::write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void lock_file(int fd, int operation) {
+    while (flock(fd, operation) != 0 && errno == EINTR) {}
+}
+
+/**
+ * 只保留最新的 capacity 条记录，在后台线程中执行。
+ * 扫描和写临时文件时不加锁；最后在排他锁内补上这期间其他会话追加的记录再 rename，
+ * 追加方持有共享锁写入，因此替换前后不会丢失记录。
+ */
+void compact_file(const std::string& path, size_t capacity) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < sizeof(FILE_MAGIC)) {
+        close(fd);
+        return;
+    }
+    uint64_t size = static_cast<uint64_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        return;
+    }
+    const char* base = static_cast<const char*>(mapping);
+
+    std::vector<uint64_t> offsets;
+    uint64_t scanned = scan_records(base, sizeof(FILE_MAGIC), size, offsets);
+    if (offsets.size() <= capacity + compaction_slack(capacity)) {
+        munmap(mapping, size);
+        close(fd);
+        return;
+    }
+    uint64_t keep_from = offsets[offsets.size() - capacity];
+
+    std::string temp_path = path + ".tmp." + std::to_string(getpid());
+    int out = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    bool ok = out >= 0 && write_all(out, FILE_MAGIC, sizeof(FILE_MAGIC)) &&
+              write_all(out, base + keep_from, scanned - keep_from);
+    munmap(mapping, size);
+
+    if (ok) {
+        lock_file(fd, LOCK_EX);
+        // 另一个会话已经完成了压缩：放弃本次结果
+        struct stat current{};
+        ok = stat(path.c_str(), &current) == 0 && current.st_ino == info.st_ino && fstat(fd, &info) == 0;
+        char chunk[65536];
+        for (auto pos = static_cast<off_t>(scanned); ok && pos < info.st_size;) {
+            ssize_t n = pread(fd, chunk, sizeof(chunk), pos);
+            if (n < 0 && errno == EINTR) continue;
+            ok = n > 0 && write_all(out, chunk, static_cast<size_t>(n));
+            pos += n;
+        }
+        ok = ok && fsync(out) == 0 && std::rename(temp_path.c_str(), path.c_str()) == 0;
+        lock_file(fd, LOCK_UN);
+    }
+    if (out >= 0) close(out);
+    if (!ok) unlink(temp_path.c_str());
+    close(fd);
+}
+#endif
+
+struct HistoryState {
+    bool opened = false;
+    bool usable = false;
+    std::string file_path;
+    const char* base = nullptr; // 文件内容
+    uint64_t size = 0;
+#ifdef _WIN32
+    std::string data;
+#else
+    int fd = -1;
+    ino_t inode = 0;
+    void* mapping = nullptr;
+#endif
+
+    uint64_t frontier = 0;       // 打开时已有的记录中，尚未建立索引的部分的结束位置
+    bool frontier_done = false;
+    std::vector<uint64_t> older; // 打开时已有的记录，从新到旧按需向前扩展
+    uint64_t tail = 0;           // 已读入 newer 的部分的结束位置，之后的内容由 refresh 接着解析
+    std::vector<int64_t> newer;  // 打开后追加的记录（包括其他会话的），从旧到新；负数 -(i + 1) 指向 memory_only[i]
+    std::vector<HistoryLog::Entry> memory_only; // 无法写入文件的记录
+
+    TrigramIndex search_index; // 编号为记录的先后顺序（0 为最旧）
+    bool search_ready = false;
+
+    /**
+     * 自动提示的前缀树。打开文件时由后台线程在文件已有内容的独立副本（映射）上建立 pending_suggestions，
+     * 完成后主线程接管它并补上这期间追加的记录，之后随每次追加同步更新。
+     */
+    HistoryTrie suggestions;
+    bool suggestions_ready = false;
+    HistoryTrie pending_suggestions;
+    std::thread suggestion_builder;
+    std::atomic<bool> suggestions_built{false};
+    std::atomic<bool> cancel_suggestions{false};
+
+    std::thread compactor;
+    std::atomic<bool> compacting{false};
+    uint64_t next_check_size = 0;
+
+    ~HistoryState() {
+        stop_suggestion_builder();
+        if (compactor.joinable()) compactor.join();
+        close_file();
+    }
+
+    void close_file() {
+#ifdef _WIN32
+        data.clear();
+#else
+        if (mapping) munmap(mapping, size);
+        if (fd >= 0) close(fd);
+        mapping = nullptr;
+        fd = -1;
+#endif
+        base = nullptr;
+        size = 0;
+        usable = false;
+    }
+
+#ifndef _WIN32
+    // 文件变长后重新映射；只涉及常数次系统调用，内容由内核按页调入
+    bool remap() {
+        struct stat info{};
+        if (fstat(fd, &info) != 0) return false;
+        inode = info.st_ino;
+        auto file_size = static_cast<uint64_t>(info.st_size);
+        if (mapping && file_size == size) return true;
+        if (mapping) munmap(mapping, size);
+        mapping = nullptr;
+        base = nullptr;
+        size = 0;
+        if (file_size == 0) return true;
+        void* result = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (result == MAP_FAILED) return false;
+        mapping = result;
+        base = static_cast<const char*>(result);
+        size = file_size;
+        return true;
+    }
+
+    // 文件是否已被删除或被其他会话的压缩替换
+    bool replaced() const {
+        struct stat info{};
+        return stat(file_path.c_str(), &info) != 0 || info.st_ino != inode;
+    }
+#endif
+
+    void open() {
+        opened = true;
+        file_path = home_dir + "/duckshell/history";
+#ifdef _WIN32
+        if (!read_file(file_path, data) || data.empty()) {
+            std::ofstream out(file_path, std::ios::binary | std::ios::trunc);
+            out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+            if (!out) return;
+            data.assign(FILE_MAGIC, sizeof(FILE_MAGIC));
+        }
+        base = data.data();
+        size = data.size();
+#else
+        // O_EXCL 保证只有创建文件的会话写入文件头
+        int created = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (created >= 0) {
+            (void)write_all(created, FILE_MAGIC, sizeof(FILE_MAGIC));
+            close(created);
+        }
+        fd = ::open(file_path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+        if (fd < 0) return;
+        if (!remap()) {
+            close_file();
+            return;
+        }
+#endif
+        // 不认识的文件格式：本次会话只在内存中记录，不改动原文件
+        if (size < sizeof(FILE_MAGIC) || std::memcmp(base, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+            close_file();
+            return;
+        }
+        frontier = size;
+        frontier_done = false;
+        tail = size;
+        usable = true;
+        start_suggestion_builder();
+    }
+
+    void start_suggestion_builder() {
+        uint64_t end = size;
+#ifdef _WIN32
+        auto snapshot = std::make_shared<std::string>(data, 0, end);
+        suggestion_builder = std::thread([this, snapshot, end]() {
+            build_suggestions(snapshot->data(), end, pending_suggestions, cancel_suggestions);
+            suggestions_built = true;
+        });
+#else
+        // 主线程之后会重新映射文件，后台线程使用自己的映射
+        void* mapping = mmap(nullptr, end, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) return;
+        suggestion_builder = std::thread([this, mapping, end]() {
+            build_suggestions(static_cast<const char*>(mapping), end, pending_suggestions, cancel_suggestions);
+            munmap(mapping, end);
+            suggestions_built = true;
+        });
+#endif
+    }
+
+    void stop_suggestion_builder() {
+        cancel_suggestions = true;
+        if (suggestion_builder.joinable()) suggestion_builder.join();
+        cancel_suggestions = false;
+        suggestions_built = false;
+        suggestions_ready = false;
+        suggestions.clear();
+        pending_suggestions.clear();
+    }
+
+    void add_suggestion(uint64_t offset, uint64_t end) {
+        suggestions.insert(base, offset + sizeof(RecordHeader), static_cast<uint32_t>(end - offset - RECORD_OVERHEAD),
+                           offset);
+    }
+
+    // 后台建立完成后接管前缀树，并补上打开之后追加的记录
+    void adopt_suggestions() {
+        if (suggestions_ready || !suggestions_built) return;
+        suggestion_builder.join();
+        suggestions = std::move(pending_suggestions);
+        pending_suggestions.clear();
+        uint64_t end = 0;
+        for (int64_t ref : newer) {
+            if (ref >= 0 && record_at(base, size, static_cast<uint64_t>(ref), end)) {
+                add_suggestion(static_cast<uint64_t>(ref), end);
+            }
+        }
+        suggestions_ready = true;
+    }
+
+    void ensure_open() {
+        if (!opened) open();
+    }
+
+    // 文件被替换后重新打开，索引从新文件末尾重新按需建立
+    void reopen() {
+        stop_suggestion_builder();
+        close_file();
+        older.clear();
+        newer.clear();
+        memory_only.clear();
+        search_index.clear();
+        search_ready = false;
+        next_check_size = 0;
+        open();
+    }
+
+    // 向前再索引一条旧记录
+    bool extend_older() {
+        if (!usable || frontier_done) return false;
+        uint64_t start = 0;
+        if (record_before(base, frontier, start)) {
+            older.push_back(start);
+            frontier = start;
+            return true;
+        }
+        // 向前定位失败（到达文件头或遇到残缺记录）：顺序扫描剩余部分，一次补全索引
+        frontier_done = true;
+        std::vector<uint64_t> rest;
+        scan_records(base, sizeof(FILE_MAGIC), frontier, rest);
+        older.insert(older.end(), rest.rbegin(), rest.rend());
+        return !rest.empty();
+    }
+
+    size_t total() const {
+        return older.size() + newer.size();
+    }
+
+    bool get(size_t age, HistoryLog::Entry& entry) {
+        ensure_open();
+        if (age == 0) return false;
+        if (age <= newer.size()) {
+            int64_t ref = newer[newer.size() - age];
+            if (ref < 0) {
+                entry = memory_only[static_cast<size_t>(-ref - 1)];
+                return true;
+            }
+            return decode_record(base, size, static_cast<uint64_t>(ref), entry);
+        }
+        size_t index = age - newer.size() - 1;
+        while (older.size() <= index && extend_older()) {}
+        if (index >= older.size()) return false;
+        return decode_record(base, size, older[index], entry);
+    }
+
+    // 写入一条记录；写入的记录与其他会话的记录一样，由随后的 refresh 读入
+    bool write_record(const std::string& record) {
+#ifdef _WIN32
+        std::lock_guard<std::mutex> lock(file_mutex);
+        std::ofstream out(file_path, std::ios::binary | std::ios::app);
+        out.write(record.data(), static_cast<std::streamsize>(record.size()));
+        return static_cast<bool>(out);
+#else
+        for (int attempt = 0; attempt < 3 && usable; ++attempt) {
+            // 共享锁只与压缩时的排他锁互斥，多个会话的追加之间互不等待
+            lock_file(fd, LOCK_SH);
+            if (replaced()) {
+                lock_file(fd, LOCK_UN);
+                reopen();
+                continue;
+            }
+            // O_APPEND 下一次 write 整条追加到文件末尾，多个会话同时追加也不会交错
+            ssize_t written = ::write(fd, record.data(), record.size());
+            lock_file(fd, LOCK_UN);
+            return written == static_cast<ssize_t>(record.size());
+        }
+        return false;
+#endif
+    }
+
+    /**
+     * 读入上次之后文件新增的记录。只解析 tail 之后的部分，不加锁；
+     * 其他会话正在写入、尚不完整的记录留到下次。文件被压缩替换后重新打开。
+     */
+    void refresh() {
+        ensure_open();
+        if (!usable) return;
+#ifdef _WIN32
+        std::string added;
+        bool shrunk = false;
+        {
+            std::lock_guard<std::mutex> lock(file_mutex);
+            std::ifstream in(file_path, std::ios::binary | std::ios::ate);
+            if (!in) return;
+            auto file_size = static_cast<uint64_t>(in.tellg());
+            shrunk = file_size < data.size();
+            if (file_size > data.size()) {
+                in.seekg(static_cast<std::streamoff>(data.size()));
+                added.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            }
+        }
+        // 文件变短说明已被压缩替换
+        if (shrunk) {
+            reopen();
+            return;
+        }
+        data += added;
+        base = data.data();
+        size = data.size();
+#else
+        if (replaced()) {
+            reopen();
+            return;
+        }
+        if (!remap()) return;
+#endif
+        std::vector<uint64_t> found;
+        tail = scan_records(base, tail, size, found);
+        uint64_t end = 0;
+        for (uint64_t offset : found) {
+            newer.push_back(static_cast<int64_t>(offset));
+            if (!record_at(base, size, offset, end)) continue;
+            if (search_ready) search_index.add(static_cast<uint32_t>(total() - 1), record_text(base, offset, end));
+            if (suggestions_ready) add_suggestion(offset, end);
+        }
+    }
+
+    void append(const HistoryLog::Entry& entry) {
+        ensure_open();
+        bool written = usable && entry.command.size() <= MAX_COMMAND_LENGTH && write_record(encode_record(entry));
+        if (written) {
+            refresh();
+            compact_if_needed();
+            return;
+        }
+        memory_only.push_back(entry);
+        newer.push_back(-static_cast<int64_t>(memory_only.size()));
+        if (search_ready) search_index.add(static_cast<uint32_t>(total() - 1), entry.command);
+    }
+
+    // 首次搜索时定位全部记录并建立索引，之后由 refresh 与 append 增量维护；命令文本直接取自映射的文件，不做复制
+    void ensure_search_index() {
+        if (search_ready) return;
+        while (extend_older()) {}
+        search_index.clear();
+        uint32_t id = 0;
+        uint64_t end = 0;
+        for (auto it = older.rbegin(); it != older.rend(); ++it, ++id) {
+            if (record_at(base, size, *it, end)) {
+                search_index.add(id, record_text(base, *it, end));
+            }
+        }
+        HistoryLog::Entry entry;
+        for (size_t i = 0; i < newer.size(); ++i, ++id) {
+            if (get(newer.size() - i, entry)) search_index.add(id, entry.command);
+        }
+        search_ready = true;
+    }
+
+    bool suggest(const std::string& prefix, std::string& command) {
+        ensure_open();
+        adopt_suggestions();
+        if (!suggestions_ready || prefix.empty()) return false;
+        uint64_t record = suggestions.find(base, prefix);
+        HistoryLog::Entry entry;
+        if (record == HistoryTrie::NPOS || !decode_record(base, size, record, entry)) return false;
+        command = std::move(entry.command);
+        return true;
+    }
+
+    bool search(const std::string& query, size_t& age, HistoryLog::Entry& entry) {
+        ensure_open();
+        if (query.empty()) return false;
+        ensure_search_index();
+        size_t count = total();
+        if (age >= count) return false;
+
+        if (!TrigramIndex::usable(query)) {
+            // 不足三个字节的查询无法用索引：从新到旧顺序查找，常见的短串通常在最近的记录中就能找到
+            for (size_t candidate = age + 1; candidate <= count; ++candidate) {
+                if (get(candidate, entry) && HistoryLog::find_text(entry.command, query) != std::string::npos) {
+                    age = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // 第 age 条之前的记录编号都小于 count - age；索引只给出候选，逐个确认直到真正包含查询串
+        auto before = static_cast<uint32_t>(count - age);
+        for (;;) {
+            uint32_t id = search_index.find_before(query, before);
+            if (id == TrigramIndex::NPOS) return false;
+            if (get(count - id, entry) && HistoryLog::find_text(entry.command, query) != std::string::npos) {
+                age = count - id;
+                return true;
+            }
+            before = id;
+        }
+    }
+
+    // 文件可能超出上限时在后台线程中清点并压缩，不阻塞提示符
+    void compact_if_needed() {
+        size_t capacity = HistoryLog::capacity();
+        uint64_t step = compaction_slack(capacity) * (RECORD_OVERHEAD + 1);
+        // 每条记录至少 RECORD_OVERHEAD + 1 字节，文件小于下面的值时条数不可能超出上限
+        uint64_t threshold = std::max<uint64_t>(next_check_size, (capacity * (RECORD_OVERHEAD + 1)) + step);
+        if (size < threshold || compacting) return;
+        if (compactor.joinable()) compactor.join();
+
+        next_check_size = size + step;
+        compacting = true;
+        compactor = std::thread([this, path = file_path, capacity]() {
+            compact_file(path, capacity);
+            compacting = false;
+        });
+    }
+};
+
+HistoryState& history_state() {
+    static HistoryState state;
+    return state;
+}
+
+} // namespace
+
+void HistoryLog::append(const Entry& entry) {
+    history_state().append(entry);
+}
+
+void HistoryLog::refresh() {
+    history_state().refresh();
+}
+
+bool HistoryLog::get(size_t age, Entry& entry) {
+    return history_state().get(age, entry);
+}
+
+bool HistoryLog::search(const std::string& query, size_t& age, Entry& entry) {
+    return history_state().search(query, age, entry);
+}
+
+bool HistoryLog::suggest(const std::string& prefix, std::string& command) {
+    return history_state().suggest(prefix, command);
+}
+
+size_t HistoryLog::find_text(const std::string& text, const std::string& query) {
+    bool ignore_case = std::none_of(query.begin(), query.end(),
+                                    [](char c) { return std::isupper(static_cast<unsigned char>(c)); });
+    if (!ignore_case) return text.find(query);
+    auto it = std::search(text.begin(), text.end(), query.begin(), query.end(), [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == static_cast<unsigned char>(b);
+    });
+    return it == text.end() ? std::string::npos : static_cast<size_t>(it - text.begin());
+}
+
+size_t HistoryLog::capacity() {
+    static const VariableStore::Symbol histsize = VariableStore::intern("HISTSIZE");
+    std::string value;
+    if (const Value* variable = VariableStore::get(histsize)) value = variable->to_string();
+    else if (const char* env = std::getenv("DUCKSHELL_HISTSIZE")) value = env;
+
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || parsed == 0) return DEFAULT_CAPACITY;
+    return std::max<size_t>(MIN_CAPACITY, static_cast<size_t>(parsed));
+}
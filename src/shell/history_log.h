@@ -0,0 +1,61 @@
+#ifndef HISTORY_LOG_H
+#define HISTORY_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief 持久化的命令历史
+ *
+ * 历史保存在 ~/duckshell/history，格式为只追加的日志：每条命令连同开始时间、退出码和耗时
+ * 用一次 write 追加一条记录。记录头尾都带有长度，启动时只需 mmap 文件，
+ * 从末尾按需向前建立索引，启动耗时与历史条数无关。
+ *
+ * 同时运行的多个会话共用同一个文件：追加以 O_APPEND 整条写入，互不等待；
+ * 每次显示提示符前从上次读到的位置接着解析，读入其他会话新追加的记录。
+ *
+ * 保留条数由变量 HISTSIZE（或环境变量 DUCKSHELL_HISTSIZE）设置，默认 100000 条；
+ * 文件超出上限后由后台线程截掉最旧的记录。
+ */
+class HistoryLog {
+public:
+    struct Entry {
+        std::string command;
+        int64_t timestamp = 0;    // 开始执行的时间（Unix 秒）
+        int exit_code = 0;
+        uint32_t duration_ms = 0;
+    };
+
+    // 追加一条记录
+    static void append(const Entry& entry);
+
+    // 读入其他会话在上次之后追加的记录，只解析文件新增的部分
+    static void refresh();
+
+    // 倒数第 age 条记录（1 为最新一条），不存在时返回 false
+    static bool get(size_t age, Entry& entry);
+
+    /**
+     * @brief 反向增量搜索：在第 age 条之前（更早的记录中）查找包含 query 的最新一条
+     *
+     * 首次调用时为全部历史建立三元组索引，之后每次追加同步更新；query 全为小写时不区分大小写。
+     * 找到时 age 与 entry 更新为匹配的记录。
+     */
+    static bool search(const std::string& query, size_t& age, Entry& entry);
+
+    /**
+     * @brief 自动提示：以 prefix 开头且比它更长的命令中最新的一条
+     *
+     * 由前缀树提供，查找耗时只与前缀长度有关；前缀树在启动后由后台线程建立，完成之前没有提示。
+     */
+    static bool suggest(const std::string& prefix, std::string& command);
+
+    // 当前的保留条数上限
+    static size_t capacity();
+
+    // 在 text 中查找 query 的位置：query 全为小写时不区分大小写，找不到返回 npos
+    static size_t find_text(const std::string& text, const std::string& query);
+};
+
+#endif // HISTORY_LOG_H
@@ -0,0 +1,74 @@
+#include "history_trie.h"
+
+void HistoryTrie::clear() {
+    nodes.clear();
+    nodes.push_back(Node{0, NPOS, NONE, NONE});
+}
+
+uint32_t HistoryTrie::find_child(const char* base, uint32_t node, char c) const {
+    for (uint32_t child = nodes[node].first_child; child != NONE; child = nodes[child].next_sibling) {
+        if (base[label_start(nodes[child])] == c) return child;
+    }
+    return NONE;
+}
+
+void HistoryTrie::insert(const char* base, uint64_t text, uint32_t length, uint64_t record) {
+    uint32_t node = ROOT;
+    nodes[node].newest = record;
+    uint32_t pos = 0;
+    while (pos < length) {
+        uint32_t child = find_child(base, node, base[text + pos]);
+        if (child == NONE) {
+            nodes.push_back(Node{make_label(text + pos, length - pos), record, NONE, nodes[node].first_child});
+            nodes[node].first_child = static_cast<uint32_t>(nodes.size() - 1);
+            return;
+        }
+
+        uint64_t start = label_start(nodes[child]);
+        uint32_t label_len = label_length(nodes[child]);
+        uint32_t matched = 1;
+        while (matched < label_len && pos + matched < length && base[start + matched] == base[text + pos + matched]) {
+            matched++;
+        }
+        if (matched < label_len) {
+            // 在边的中间分叉：原节点保留位置并改为只含前 matched 个字符，它原来的内容下移为新的子节点，
+            // 这样不需要在兄弟链表中查找前驱
+            Node lower = nodes[child];
+            lower.label = make_label(start + matched, label_len - matched);
+            lower.next_sibling = NONE;
+            nodes.push_back(lower);
+            nodes[child].label = make_label(start, matched);
+            nodes[child].first_child = static_cast<uint32_t>(nodes.size() - 1);
+        }
+        nodes[child].newest = record;
+        node = child;
+        pos += matched;
+    }
+}
+
+uint64_t HistoryTrie::find(const char* base, const std::string& prefix) const {
+    uint32_t node = ROOT;
+    size_t pos = 0;
+    while (pos < prefix.size()) {
+        uint32_t child = find_child(base, node, prefix[pos]);
+        if (child == NONE) return NPOS;
+        uint64_t start = label_start(nodes[child]);
+        uint32_t label_len = label_length(nodes[child]);
+        uint32_t matched = 1;
+        while (matched < label_len && pos + matched < prefix.size()) {
+            if (base[start + matched] != prefix[pos + matched]) return NPOS;
+            matched++;
+        }
+        // 前缀止于边的中间：子树中的命令都比前缀长
+        if (matched < label_len) return nodes[child].newest;
+        node = child;
+        pos += matched;
+    }
+
+    // 前缀恰好止于节点：与前缀相同的命令就在这个节点，更长的命令都在子节点中
+    uint64_t newest = NPOS;
+    for (uint32_t child = nodes[node].first_child; child != NONE; child = nodes[child].next_sibling) {
+        if (newest == NPOS || nodes[child].newest > newest) newest = nodes[child].newest;
+    }
+    return newest;
+}
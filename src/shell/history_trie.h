@@ -0,0 +1,58 @@
+#ifndef HISTORY_TRIE_H
+#define HISTORY_TRIE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 历史命令的压缩前缀树（基数树），用于输入时的自动提示
+ *
+ * 边上的文字不复制，只记下它在历史文件中的位置和长度，读取时由调用方传入文件内容的起始地址。
+ * 每个节点保存子树中最新一条记录在文件中的位置（文件只追加，位置越大越新），
+ * 查找以某个前缀开头的最新命令只需沿前缀走到对应节点，耗时与历史条数无关。
+ */
+class HistoryTrie {
+public:
+    static constexpr uint64_t NPOS = UINT64_MAX;
+
+    HistoryTrie() { clear(); }
+
+    void clear();
+
+    /**
+     * @brief 插入一条命令
+     * @param base 文件内容的起始地址
+     * @param text 命令文本在文件中的位置
+     * @param length 命令文本的长度
+     * @param record 记录在文件中的位置，必须大于之前插入的所有记录
+     */
+    void insert(const char* base, uint64_t text, uint32_t length, uint64_t record);
+
+    // 以 prefix 开头且比 prefix 更长的命令中最新一条的记录位置，没有时返回 NPOS
+    uint64_t find(const char* base, const std::string& prefix) const;
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr uint32_t ROOT = 0;
+    static constexpr int LENGTH_BITS = 24; // 命令长度不超过 1 MiB，24 位足够
+
+    struct Node {
+        uint64_t label;        // 边上文字：高 40 位为在文件中的位置，低 24 位为长度
+        uint64_t newest;       // 子树中最新一条记录的位置
+        uint32_t first_child;
+        uint32_t next_sibling;
+    };
+
+    static uint64_t make_label(uint64_t start, uint32_t length) { return (start << LENGTH_BITS) | length; }
+    static uint64_t label_start(const Node& node) { return node.label >> LENGTH_BITS; }
+    static uint32_t label_length(const Node& node) {
+        return static_cast<uint32_t>(node.label & ((uint64_t(1) << LENGTH_BITS) - 1));
+    }
+
+    uint32_t find_child(const char* base, uint32_t node, char c) const;
+
+    std::vector<Node> nodes;
+};
+
+#endif // HISTORY_TRIE_H
@@ -0,0 +1,188 @@
+#include <array>
+#include <iterator>
+
+#include "input_decoder.h"
+
+namespace {
+
+struct SequenceBinding {
+    const char* sequence; // ESC 之后的字节
+    KeyType key;
+};
+
+// xterm、VT220、rxvt 与 Linux 控制台常见的按键序列；KeyType::Paste 表示粘贴开始
+constexpr SequenceBinding ESCAPE_SEQUENCES[] = {
+    {"[A", KeyType::Up},          {"[B", KeyType::Down},        {"[C", KeyType::Right},
+    {"[D", KeyType::Left},        {"OA", KeyType::Up},          {"OB", KeyType::Down},
+    {"OC", KeyType::Right},       {"OD", KeyType::Left},        {"[H", KeyType::Home},
+    {"[F", KeyType::End},         {"OH", KeyType::Home},        {"OF", KeyType::End},
+    {"[1~", KeyType::Home},       {"[7~", KeyType::Home},       {"[4~", KeyType::End},
+    {"[8~", KeyType::End},        {"[3~", KeyType::Delete},     {"[1;5C", KeyType::WordRight},
+    {"[1;5D", KeyType::WordLeft}, {"[1;3C", KeyType::WordRight}, {"[1;3D", KeyType::WordLeft},
+    {"[5C", KeyType::WordRight},  {"[5D", KeyType::WordLeft},   {"Oc", KeyType::WordRight},
+    {"Od", KeyType::WordLeft},    {"b", KeyType::WordLeft},     {"f", KeyType::WordRight},
+    {"[200~", KeyType::Paste},
+};
+
+struct TrieNode {
+    char ch = 0;
+    int16_t first_child = -1;
+    int16_t next_sibling = -1;
+    int16_t binding = -1; // ESCAPE_SEQUENCES 中的下标
+};
+
+constexpr size_t MAX_TRIE_NODES = 96;
+
+struct SequenceTrie {
+    std::array<TrieNode, MAX_TRIE_NODES> nodes{};
+    size_t size = 1; // 0 号节点为根，对应刚读到 ESC
+
+    constexpr int16_t find(int16_t parent, char c) const {
+        int16_t child = nodes[parent].first_child;
+        while (child >= 0 && nodes[child].ch != c) child = nodes[child].next_sibling;
+        return child;
+    }
+};
+
+constexpr SequenceTrie build_sequence_trie() {
+    SequenceTrie trie{};
+    for (size_t b = 0; b < std::size(ESCAPE_SEQUENCES); ++b) {
+        int16_t node = 0;
+        for (const char* p = ESCAPE_SEQUENCES[b].sequence; *p != '\0'; ++p) {
+            int16_t child = trie.find(node, *p);
+            if (child < 0) {
+                child = static_cast<int16_t>(trie.size++);
+                trie.nodes[child].ch = *p;
+                trie.nodes[child].next_sibling = trie.nodes[node].first_child;
+                trie.nodes[node].first_child = child;
+            }
+            node = child;
+        }
+        trie.nodes[node].binding = static_cast<int16_t>(b);
+    }
+    return trie;
+}
+
+constexpr SequenceTrie SEQUENCE_TRIE = build_sequence_trie();
+static_assert(SEQUENCE_TRIE.size <= MAX_TRIE_NODES, "enlarge MAX_TRIE_NODES");
+
+struct ControlBinding {
+    unsigned char byte;
+    KeyType key;
+};
+
+constexpr ControlBinding CONTROL_BINDINGS[] = {
+    {1, KeyType::Home},         {3, KeyType::Interrupt},    {5, KeyType::End},
+    {7, KeyType::Cancel},       {8, KeyType::Backspace},    {9, KeyType::Tab},
+    {10, KeyType::Enter},       {11, KeyType::KillToEnd},   {12, KeyType::ClearScreen},
+    {13, KeyType::Enter},       {18, KeyType::SearchHistory}, {21, KeyType::KillToStart},
+    {23, KeyType::KillWordBack}, {127, KeyType::Backspace},
+};
+
+// 控制字节到 CONTROL_BINDINGS 下标的查找表，-1 表示未绑定
+constexpr std::array<int8_t, 128> build_control_table() {
+    std::array<int8_t, 128> table{};
+    for (auto& slot : table) slot = -1;
+    for (size_t i = 0; i < std::size(CONTROL_BINDINGS); ++i) {
+        table[CONTROL_BINDINGS[i].byte] = static_cast<int8_t>(i);
+    }
+    return table;
+}
+
+constexpr std::array<int8_t, 128> CONTROL_TABLE = build_control_table();
+
+constexpr char PASTE_END[] = "\033[201~";
+constexpr size_t PASTE_END_LENGTH = sizeof(PASTE_END) - 1;
+
+} // namespace
+
+bool InputDecoder::control_key(unsigned char byte, KeyType& key) {
+    if (byte >= CONTROL_TABLE.size() || CONTROL_TABLE[byte] < 0) return false;
+    key = CONTROL_BINDINGS[CONTROL_TABLE[byte]].key;
+    return true;
+}
+
+void InputDecoder::feed_ground(char c, std::vector<KeyEvent>& events) {
+    auto byte = static_cast<unsigned char>(c);
+    if (byte == 27) {
+        state = State::Sequence;
+        node = 0;
+        return;
+    }
+
+    KeyType key;
+    if (control_key(byte, key)) {
+        events.push_back({key, {}});
+    }
+    else if (byte >= 32) {
+        if (!events.empty() && events.back().type == KeyType::Text) events.back().text += c;
+        else events.push_back({KeyType::Text, std::string(1, c)});
+    }
+}
+
+void InputDecoder::feed(const char* data, size_t length, std::vector<KeyEvent>& events) {
+    for (size_t i = 0; i < length; ++i) {
+        char c = data[i];
+        auto byte = static_cast<unsigned char>(c);
+
+        switch (state) {
+            case State::Ground:
+                feed_ground(c, events);
+                break;
+
+            case State::Sequence: {
+                int16_t child = SEQUENCE_TRIE.find(node, c);
+                if (child >= 0) {
+                    if (node == 0) in_csi = c == '[';
+                    const TrieNode& next = SEQUENCE_TRIE.nodes[child];
+                    if (next.binding >= 0 && next.first_child < 0) {
+                        KeyType key = ESCAPE_SEQUENCES[next.binding].key;
+                        if (key == KeyType::Paste) {
+                            state = State::Paste;
+                            pasted.clear();
+                        }
+                        else {
+                            events.push_back({key, {}});
+                            state = State::Ground;
+                        }
+                    }
+                    else {
+                        node = child;
+                    }
+                    break;
+                }
+
+                // 不认识的序列：CSI 需要跳过直到结束字节（0x40-0x7E），ESC 后直接跟普通字符时按普通输入处理
+                state = State::Ground;
+                if (node == 0) {
+                    feed_ground(c, events);
+                }
+                else if (in_csi && !(byte >= 0x40 && byte <= 0x7E)) {
+                    state = State::SkipCsi;
+                }
+                break;
+            }
+
+            case State::SkipCsi:
+                if (byte >= 0x40 && byte <= 0x7E) state = State::Ground;
+                break;
+
+            case State::Paste:
+                pasted += c;
+                if (pasted.size() >= PASTE_END_LENGTH &&
+                    pasted.compare(pasted.size() - PASTE_END_LENGTH, PASTE_END_LENGTH, PASTE_END) == 0) {
+                    pasted.resize(pasted.size() - PASTE_END_LENGTH);
+                    events.push_back({KeyType::Paste, std::move(pasted)});
+                    pasted.clear();
+                    state = State::Ground;
+                }
+                break;
+        }
+    }
+}
+
+void InputDecoder::timeout(std::vector<KeyEvent>& events) {
+    if (state != State::Sequence) return;
+    if (node == 0) events.push_back({KeyType::Escape, {}});
+    state = State::Ground;
+}
@@ -0,0 +1,70 @@
+#ifndef INPUT_DECODER_H
+#define INPUT_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class KeyType {
+    Text,         // 可打印文本，连续输入的字符合并为一个事件
+    Paste,        // 括号粘贴模式下的一整段粘贴内容
+    Enter,
+    Tab,
+    Backspace,
+    Delete,
+    Up,
+    Down,
+    Left,
+    Right,
+    Home,         // Home / Ctrl+A
+    End,          // End / Ctrl+E
+    WordLeft,     // Ctrl+Left / Alt+B
+    WordRight,    // Ctrl+Right / Alt+F
+    KillToEnd,    // Ctrl+K
+    KillToStart,  // Ctrl+U
+    KillWordBack, // Ctrl+W
+    ClearScreen,  // Ctrl+L
+    SearchHistory, // Ctrl+R
+    Cancel,       // Ctrl+G
+    Interrupt,    // Ctrl+C
+    Escape,       // 单独按下的 ESC
+};
+
+struct KeyEvent {
+    KeyType type;
+    std::string text; // Text / Paste 的内容
+};
+
+/**
+ * @brief 终端输入解码状态机
+ *
+ * 按块接收从终端读到的字节，解析出按键事件。转义序列由编译期生成的前缀树匹配，
+ * 可以跨越两次读取；括号粘贴（ESC[200~ ... ESC[201~）之间的内容原样收集，
+ * 作为一个 Paste 事件交给编辑器一次性插入。
+ */
+class InputDecoder {
+public:
+    void feed(const char* data, size_t length, std::vector<KeyEvent>& events);
+
+    // 是否停在一个未完成的转义序列中间，此时调用方应短暂等待后续字节
+    bool pending_escape() const { return state == State::Sequence; }
+
+    // 等待超时：单独的 ESC 作为 Escape 键，其余未完成的序列丢弃
+    void timeout(std::vector<KeyEvent>& events);
+
+    // 单个控制字节（0-31 与 127）对应的按键，没有绑定时返回 false
+    static bool control_key(unsigned char byte, KeyType& key);
+
+private:
+    enum class State { Ground, Sequence, SkipCsi, Paste };
+
+    void feed_ground(char c, std::vector<KeyEvent>& events);
+
+    State state = State::Ground;
+    int16_t node = 0;    // 转义序列前缀树中的当前节点
+    bool in_csi = false; // 当前序列是否以 ESC [ 开头
+    std::string pasted; // 正在收集的粘贴内容
+};
+
+#endif // INPUT_DECODER_H
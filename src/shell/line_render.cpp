@@ -0,0 +1,421 @@
+#include <algorithm>
+#include <cstddef>
+
+#include "../header.h"
+#include "line_render.h"
+#include "shell_listing.h"
+#include "unicode_width.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+size_t visible_width(const std::string& text) {
+    size_t width = 0;
+    size_t segment = 0; // 当前尚未计入宽度的普通文本的起点
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\033' && i + 1 < text.size() && text[i + 1] == '[') {
+            width += text_width(text, segment, i);
+            // 跳过 CSI 序列直到结束字节（0x40-0x7E）
+            i += 2;
+            while (i < text.size() && (text[i] < 0x40 || text[i] > 0x7E)) i++;
+            segment = i + 1;
+            continue;
+        }
+        if (text[i] == '\r' || text[i] == '\n') {
+            width = 0;
+            segment = i + 1;
+        }
+    }
+    return width + text_width(text, std::min(segment, text.size()), text.size());
+}
+
+static void append_csi(std::string& out, size_t count, char command) {
+    if (count == 0) return;
+    out += "\033[";
+    if (count > 1) out += std::to_string(count);
+    out += command;
+}
+
+// 光标从 from_col 横向移动到 to_col
+static void append_move(std::string& out, size_t from_col, size_t to_col) {
+    if (to_col < from_col) {
+        size_t n = from_col - to_col;
+        if (n == 1) out += '\b';
+        else append_csi(out, n, 'D');
+    }
+    else {
+        append_csi(out, to_col - from_col, 'C');
+    }
+}
+
+static HighlightStyle style_at(const std::vector<HighlightStyle>& styles, size_t pos) {
+    return pos < styles.size() ? styles[pos] : HighlightStyle::Plain;
+}
+
+// 输出 text 的 [from, to)，样式变化处插入颜色序列，结束时恢复默认样式
+static void append_styled(std::string& out, const std::string& text, const std::vector<HighlightStyle>& styles,
+                          size_t from, size_t to) {
+    HighlightStyle current = HighlightStyle::Plain;
+    for (size_t i = from; i < to;) {
+        HighlightStyle style = style_at(styles, i);
+        size_t run = i + 1;
+        while (run < to && style_at(styles, run) == style) run++;
+        if (style != current) out += highlight_sgr(style);
+        current = style;
+        out.append(text, i, run - i);
+        i = run;
+    }
+    if (current != HighlightStyle::Plain) out += highlight_sgr(HighlightStyle::Plain);
+}
+
+void LineRenderer::emit(const std::string& out) {
+    if (out.empty()) return;
+    // 先把 cout 中尚未输出的内容刷出，保证顺序
+    std::cout.flush();
+#ifdef _WIN32
+    std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+    std::cout.flush();
+#else
+    size_t written = 0;
+    while (written < out.size()) {
+        ssize_t n = ::write(STDOUT_FILENO, out.data() + written, out.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+#endif
+}
+
+const std::string& LineRenderer::continuation_prompt() {
+    static const std::string prompt = "> ";
+    return prompt;
+}
+
+static size_t count_breaks(const std::string& text) {
+    return static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+}
+
+// 尚未计算宽度的行
+static constexpr size_t UNKNOWN_WIDTH = static_cast<size_t>(-1);
+
+size_t LineRenderer::prefix_width(size_t line) const {
+    static const size_t continuation_width = visible_width(continuation_prompt());
+    return line == 0 ? prompt_width : continuation_width;
+}
+
+// 一行（连同提示符）占用的屏幕行数。恰好写满最后一列时光标停在下一屏幕行的开头，那一行也算在内
+size_t LineRenderer::rows(size_t line) const {
+    return (prefix_width(line) + lines[line].width) / columns + 1;
+}
+
+size_t LineRenderer::first_row(size_t line) const {
+    size_t row = 0;
+    for (size_t i = 0; i < line; ++i) row += rows(i);
+    return row;
+}
+
+/**
+ * 第 line 行从开头写到字节 pos 时所在的列（不考虑折行，含提示符）。宽字符在当前屏幕行放不下时
+ * 终端把它整个移到下一行，空出的列也计算在内
+ */
+size_t LineRenderer::column_at(const std::string& text, size_t line, size_t start, size_t pos) const {
+    size_t column = prefix_width(line);
+    size_t plain = text_width(text, start, pos);
+    if (column + plain < columns) return column + plain;
+    for (size_t i = start; i < pos;) {
+        size_t next = next_grapheme(text, i);
+        size_t width = text_width(text, i, next);
+        if (width > 1 && column % columns + width > columns) column += columns - column % columns;
+        column += width;
+        i = next;
+    }
+    return column;
+}
+
+void LineRenderer::move_to(std::string& out, size_t row, size_t col) {
+    if (row < screen_row) append_csi(out, screen_row - row, 'A');
+    else append_csi(out, row - screen_row, 'B');
+    append_move(out, screen_col, col);
+    screen_row = row;
+    screen_col = col;
+}
+
+// 移到第 line 行中（不考虑折行时）的第 column 列
+void LineRenderer::move_to_column(std::string& out, size_t line, size_t column) {
+    move_to(out, first_row(line) + column / columns, column % columns);
+}
+
+void LineRenderer::begin(const std::string& prompt_text) {
+    prompt = prompt_text;
+    prompt_width = visible_width(prompt);
+    prompt_breaks = count_breaks(prompt);
+    columns = terminal_width();
+    shown.clear();
+    shown_styles.clear();
+    lines.assign(1, Line{0, 0, 0});
+    shown_cursor = 0;
+    cursor_line = 0;
+    cursor_column = prompt_width;
+    dirty = false;
+    fresh = false;
+    pending.clear();
+
+    std::string out = prompt;
+    if (prompt_width > 0 && prompt_width % columns == 0) out += " \r\033[K";
+    screen_row = prompt_width / columns;
+    screen_col = prompt_width % columns;
+    emit(out);
+}
+
+void LineRenderer::set_prompt(const std::string& prompt_text) {
+    prompt = prompt_text;
+    prompt_width = visible_width(prompt);
+    dirty = true;
+}
+
+// 同一段文本中从字节 from 移到字节 to 的列偏移，只计算两者之间的部分
+static std::ptrdiff_t column_offset(const std::string& text, size_t from, size_t to) {
+    if (to >= from) return static_cast<std::ptrdiff_t>(text_width(text, from, to));
+    return -static_cast<std::ptrdiff_t>(text_width(text, to, from));
+}
+
+/**
+ * 输出 [from, to) 各行。第 from 行为第一行时终端光标须位于提示符之后，否则位于上一行的末尾，
+ * 由这里换行后连同续行提示符一起输出（新增的行在屏幕上还不存在，不能直接移过去）。
+ * 每行末尾清除本屏幕行的剩余部分，to_end 时最后清除到屏幕末尾，去掉原来更长的内容
+ */
+void LineRenderer::draw_lines(std::string& out, const std::string& buffer, const std::vector<HighlightStyle>& styles,
+                              size_t from, size_t to, bool to_end) {
+    size_t row = first_row(from);
+    for (size_t i = from; i < to; ++i) {
+        if (i > 0) {
+            out += "\r\n";
+            out += continuation_prompt();
+        }
+        size_t end_column = prefix_width(i) + lines[i].width;
+        if (end_column < columns) {
+            append_styled(out, buffer, styles, lines[i].start, lines[i].end);
+        }
+        else {
+            // 宽字符放不下时终端跳过屏幕行的最后一列，先清掉这一列上次留下的内容
+            size_t column = prefix_width(i);
+            size_t written = lines[i].start;
+            for (size_t pos = lines[i].start; pos < lines[i].end;) {
+                size_t next = next_grapheme(buffer, pos);
+                size_t width = text_width(buffer, pos, next);
+                if (width > 1 && column % columns + width > columns) {
+                    append_styled(out, buffer, styles, written, pos);
+                    out += "\033[K";
+                    written = pos;
+                    column += columns - column % columns;
+                }
+                column += width;
+                pos = next;
+            }
+            append_styled(out, buffer, styles, written, lines[i].end);
+        }
+        // 恰好写满最后一列时终端光标停在行尾等待折行，补一个空格让它折到下一屏幕行的开头，再由清除擦掉
+        if (end_column > 0 && end_column % columns == 0) out += " \r";
+        out += to_end && i + 1 == to ? "\033[J" : "\033[K";
+        screen_row = row + end_column / columns;
+        screen_col = end_column % columns;
+        row += rows(i);
+    }
+}
+
+// 从提示符的第一行开始重绘提示符和全部内容
+void LineRenderer::redraw_all(std::string& out, const std::string& buffer, const std::vector<HighlightStyle>& styles) {
+    if (!fresh) {
+        move_to(out, 0, 0);
+        append_csi(out, prompt_breaks, 'A');
+    }
+    out += '\r';
+    out += prompt;
+    prompt_breaks = count_breaks(prompt);
+    draw_lines(out, buffer, styles, 0, lines.size(), true);
+    dirty = false;
+    fresh = false;
+}
+
+/**
+ * 只有第 index 行变化时，找出新旧内容（文字与样式都相同）的公共前缀与公共后缀，在行内按差异更新。
+ * 超出一行时 CSI 的插入/删除和横向移动都无法跨行，返回 false 由调用方重绘；line 为新的一行，宽度在这里算出
+ */
+bool LineRenderer::edit_line(std::string& out, const std::string& buffer, const std::vector<HighlightStyle>& styles,
+                             size_t index, Line& line) {
+    const Line& old = lines[index];
+    auto same = [&](size_t shown_pos, size_t buffer_pos) {
+        return shown[shown_pos] == buffer[buffer_pos] &&
+               style_at(shown_styles, shown_pos) == style_at(styles, buffer_pos);
+    };
+
+    // 之前的各行都相同，两行的起点一致；前后缀对齐到字素簇边界，避免把组合字符与基字符拆开输出
+    const size_t start = line.start;
+    size_t limit = std::min(old.end, line.end);
+    size_t prefix = start;
+    while (prefix < limit && same(prefix, prefix)) prefix++;
+    while (prefix > start && !(is_grapheme_boundary(shown, prefix) && is_grapheme_boundary(buffer, prefix))) prefix--;
+    size_t suffix = 0;
+    while (suffix < limit - prefix && same(old.end - 1 - suffix, line.end - 1 - suffix)) suffix++;
+    while (suffix > 0 && !(is_grapheme_boundary(shown, old.end - suffix) &&
+                           is_grapheme_boundary(buffer, line.end - suffix))) {
+        suffix--;
+    }
+
+    // 列数只对变化的部分计算，整行宽度由上一次的结果增量得出
+    size_t old_end = old.end - suffix;
+    size_t new_end = line.end - suffix;
+    size_t old_width = text_width(shown, prefix, old_end);
+    size_t new_width = text_width(buffer, prefix, new_end);
+    line.width = old.width - old_width + new_width;
+    if (prefix_width(index) + std::max(old.width, line.width) >= columns) {
+        line.width = UNKNOWN_WIDTH; // 折行后宽字符可能留出空列，由调用方逐字计算
+        return false;
+    }
+
+    size_t prefix_col = cursor_line == index
+                            ? cursor_column + column_offset(shown, shown_cursor, prefix)
+                            : prefix_width(index) + text_width(shown, start, prefix);
+    move_to_column(out, index, prefix_col);
+
+    if (old_end == prefix && suffix > 0) {
+        // 纯插入：先腾出位置再写入新字符
+        append_csi(out, new_width, '@');
+        append_styled(out, buffer, styles, prefix, new_end);
+        screen_col = prefix_col + new_width;
+    }
+    else if (new_end == prefix && old_width > 0) {
+        // 纯删除：后面的字符由终端左移
+        append_csi(out, old_width, 'P');
+    }
+    else if (old_width == new_width && old_width > 0) {
+        append_styled(out, buffer, styles, prefix, new_end);
+        screen_col = prefix_col + new_width;
+    }
+    else {
+        append_styled(out, buffer, styles, prefix, line.end);
+        if (line.width < old.width) out += "\033[K";
+        screen_col = prefix_width(index) + line.width;
+    }
+    return true;
+}
+
+/**
+ * 把终端光标移到 cursor 处。unchanged 之前的行没有变化，光标仍在其中同一个不折行的行时列数由上一次的位置增量得出，
+ * 单步移动时计算量与行长无关
+ */
+void LineRenderer::place_cursor(std::string& out, const std::string& buffer, size_t cursor, size_t unchanged) {
+    auto it = std::upper_bound(lines.begin(), lines.end(), cursor,
+                               [](size_t pos, const Line& line) { return pos < line.start; });
+    size_t line = static_cast<size_t>(it - lines.begin()) - 1;
+    bool single_row = prefix_width(line) + lines[line].width < columns;
+    size_t column = single_row && line == cursor_line && line < unchanged
+                        ? cursor_column + column_offset(buffer, shown_cursor, cursor)
+                        : column_at(buffer, line, lines[line].start, cursor);
+    move_to_column(out, line, column);
+    shown_cursor = cursor;
+    cursor_line = line;
+    cursor_column = column;
+}
+
+void LineRenderer::render(const std::string& buffer, size_t cursor, const std::vector<HighlightStyle>& styles) {
+    std::string out;
+    out.swap(pending);
+    cursor = std::min(cursor, buffer.size());
+
+    std::vector<Line> next;
+    for (size_t start = 0;;) {
+        size_t end = std::min(buffer.find('\n', start), buffer.size());
+        next.push_back(Line{start, end, UNKNOWN_WIDTH});
+        if (end == buffer.size()) break;
+        start = end + 1;
+    }
+
+    size_t width = terminal_width();
+    if (dirty || fresh || width != columns) {
+        columns = width;
+        lines.swap(next);
+        for (size_t i = 0; i < lines.size(); ++i) {
+            lines[i].width = column_at(buffer, i, lines[i].start, lines[i].end) - prefix_width(i);
+        }
+        redraw_all(out, buffer, styles);
+        place_cursor(out, buffer, cursor, 0);
+    }
+    else {
+        auto same_line = [&](const Line& a, const Line& b) {
+            size_t length = a.end - a.start;
+            if (length != b.end - b.start || shown.compare(a.start, length, buffer, b.start, length) != 0) return false;
+            for (size_t i = 0; i < length; ++i) {
+                if (style_at(shown_styles, a.start + i) != style_at(styles, b.start + i)) return false;
+            }
+            return true;
+        };
+
+        // 开头和末尾没有变化的行。第一行前面是提示符，其余行前面是续行提示符，末尾相同的行不包括第一行
+        size_t first = 0;
+        while (first < lines.size() && first < next.size() && same_line(lines[first], next[first])) {
+            next[first].width = lines[first].width;
+            first++;
+        }
+        size_t common = 0;
+        while (first + common + 1 < lines.size() && first + common + 1 < next.size() &&
+               same_line(lines[lines.size() - 1 - common], next[next.size() - 1 - common])) {
+            next[next.size() - 1 - common].width = lines[lines.size() - 1 - common].width;
+            common++;
+        }
+        size_t old_changed_end = lines.size() - common;
+        size_t new_changed_end = next.size() - common;
+
+        if (first < old_changed_end || first < new_changed_end) {
+            bool edited = lines.size() == next.size() && new_changed_end == first + 1 &&
+                          edit_line(out, buffer, styles, first, next[first]);
+            if (!edited) {
+                size_t old_rows = 0;
+                for (size_t i = first; i < old_changed_end; ++i) old_rows += rows(i);
+                lines.swap(next);
+                size_t new_rows = 0;
+                for (size_t i = first; i < new_changed_end; ++i) {
+                    if (lines[i].width == UNKNOWN_WIDTH) {
+                        lines[i].width = column_at(buffer, i, lines[i].start, lines[i].end) - prefix_width(i);
+                    }
+                    new_rows += rows(i);
+                }
+                // 变化的行占用的屏幕行数不变时，后面的行留在原处；否则重绘到末尾
+                size_t from = std::min(first, lines.size() - 1);
+                bool keep_tail = old_rows == new_rows && first < new_changed_end;
+                if (from == 0) move_to_column(out, 0, prompt_width);
+                else move_to_column(out, from - 1, prefix_width(from - 1) + lines[from - 1].width);
+                draw_lines(out, buffer, styles, from, keep_tail ? new_changed_end : lines.size(), !keep_tail);
+            }
+            else {
+                lines.swap(next);
+            }
+        }
+        place_cursor(out, buffer, cursor, first);
+    }
+
+    emit(out);
+    shown = buffer;
+    shown_styles = styles;
+}
+
+void LineRenderer::finish(const std::string& marker) {
+    std::string out;
+    size_t last = lines.size() - 1;
+    move_to_column(out, last, prefix_width(last) + lines[last].width);
+    out += marker;
+    out += '\n';
+    emit(out);
+    shown.clear();
+    shown_styles.clear();
+    lines.assign(1, Line{0, 0, 0});
+    shown_cursor = 0;
+    cursor_line = 0;
+    cursor_column = 0;
+    screen_row = 0;
+    screen_col = 0;
+}
@@ -0,0 +1,86 @@
+#ifndef LINE_RENDER_H
+#define LINE_RENDER_H
+
+#include <string>
+#include <vector>
+
+#include "syntax_highlight.h"
+
+/**
+ * @brief 输入行的屏幕模型
+ *
+ * 记录终端上当前显示的缓冲区内容和光标位置，每次按键只输出新旧内容之间的差异：
+ * 插入用 CSI @，删除用 CSI P，光标移动用 CSI C / CSI D，
+ * 并把一次更新的全部输出合并成一次 write。文字和高亮样式一起比较，只有颜色变化的部分同样按差异重绘。列数按字符的显示宽度计算（中文等宽字符占两列），
+ * 光标列与整行宽度随每次更新增量维护。
+ *
+ * 缓冲区可以有多行（以 '\n' 分隔），第一行接在提示符之后，其余各行前显示续行提示符。
+ * 超出终端宽度的行按折行后占用的屏幕行数排布，只重绘内容有变化的行；
+ * 变化后各行占用的屏幕行数不变时，后面的行保持不动。
+ */
+class LineRenderer {
+public:
+    // 输出提示符，开始编辑新的一行
+    void begin(const std::string& prompt);
+
+    // 把屏幕更新为 buffer，光标位于字节偏移 cursor 处；styles 为每个字节的高亮样式（可以为空）
+    void render(const std::string& buffer, size_t cursor, const std::vector<HighlightStyle>& styles);
+
+    // 更换提示符（例如进入历史搜索），下一次 render 完整重绘提示符和全部内容
+    void set_prompt(const std::string& prompt);
+
+    // 屏幕内容已不可信（清屏、输出了其他内容），光标位于新的一行开头，下一次 render 在这里完整重绘
+    void invalidate() { fresh = true; }
+
+    // 响铃，与下一次 render 的输出一起写出
+    void bell() { pending += '\a'; }
+
+    // 光标移到内容末尾，输出 marker（例如 Ctrl+C 时的 "^C"）并换行，结束本行编辑
+    void finish(const std::string& marker = "");
+
+    // 续行提示符
+    static const std::string& continuation_prompt();
+
+private:
+    // 缓冲区中的一行
+    struct Line {
+        size_t start; // 在缓冲区中的字节范围
+        size_t end;
+        size_t width; // 内容占用的列数（不含提示符，含折行时宽字符留下的空列）
+    };
+
+    void emit(const std::string& out);
+    size_t prefix_width(size_t line) const;
+    size_t first_row(size_t line) const;
+    size_t rows(size_t line) const;
+    size_t column_at(const std::string& text, size_t line, size_t start, size_t pos) const;
+    void move_to(std::string& out, size_t row, size_t col);
+    void move_to_column(std::string& out, size_t line, size_t column);
+    void draw_lines(std::string& out, const std::string& buffer, const std::vector<HighlightStyle>& styles,
+                    size_t from, size_t to, bool to_end);
+    void redraw_all(std::string& out, const std::string& buffer, const std::vector<HighlightStyle>& styles);
+    bool edit_line(std::string& out, const std::string& buffer, const std::vector<HighlightStyle>& styles,
+                   size_t index, Line& line);
+    void place_cursor(std::string& out, const std::string& buffer, size_t cursor, size_t unchanged);
+
+    std::string prompt;
+    size_t prompt_width = 0;
+    size_t prompt_breaks = 0; // 屏幕上的提示符中的换行数，完整重绘时从提示符的第一行开始
+    std::string shown;       // 屏幕上显示的缓冲区内容
+    std::vector<HighlightStyle> shown_styles; // 屏幕上每个字节的样式
+    std::vector<Line> lines; // 屏幕上的各行
+    size_t columns = 80;     // 排布 lines 时的终端宽度
+    size_t shown_cursor = 0; // 光标对应的字节偏移
+    size_t cursor_line = 0;  // 光标所在的行
+    size_t cursor_column = 0; // 光标在所在行中的列（含提示符，未折行）
+    size_t screen_row = 0;   // 终端光标所在的屏幕行（相对于第一行内容所在的屏幕行）
+    size_t screen_col = 0;   // 终端光标所在的屏幕列
+    bool dirty = false;      // 提示符已更换，需要完整重绘
+    bool fresh = false;      // 屏幕上没有内容，光标在新的一行开头
+    std::string pending;     // 尚未写出的附加输出（响铃等）
+};
+
+// 文本在终端上占用的列数，跳过 ANSI 转义序列
+size_t visible_width(const std::string& text);
+
+#endif // LINE_RENDER_H
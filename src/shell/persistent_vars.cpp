@@ -0,0 +1,528 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../header.h"
+#include "persistent_vars.h"
+#include "variable_store.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char FILE_MAGIC[8] = {'D', 'S', 'V', 'A', 'R', '0', '1', '\n'};
+constexpr uint32_t RECORD_TAG = 0x31565344; // "DSV1"
+constexpr uint8_t FLAG_REMOVED = 1;
+constexpr uint32_t MAX_VALUE_LENGTH = 1 << 24;
+// 记录数超过该值且超过变量数的两倍时压缩
+constexpr size_t MIN_COMPACT_RECORDS = 64;
+
+// 记录头后依次是 key_length 字节的变量名和 value_length 字节的值
+struct RecordHeader {
+    uint32_t tag;
+    uint32_t checksum; // 其余字段与变量名、值的 FNV-1a
+    uint32_t value_length;
+    uint16_t key_length;
+    uint8_t type; // Value::Type
+    uint8_t flags;
+};
+static_assert(sizeof(RecordHeader) == 16, "RecordHeader must stay 16 bytes on disk");
+
+uint32_t fnv1a(uint32_t hash, const char* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t record_checksum(const RecordHeader& header, const char* key, const char* value) {
+    uint32_t hash = 2166136261u;
+    hash = fnv1a(hash, reinterpret_cast<const char*>(&header.value_length), sizeof(RecordHeader) - 8);
+    hash = fnv1a(hash, key, header.key_length);
+    return fnv1a(hash, value, header.value_length);
+}
+
+struct Record {
+    std::string_view key;
+    std::string_view payload;
+    uint8_t type;
+    uint8_t flags;
+    std::string_view bytes; // 整条记录，压缩时原样写出
+};
+
+enum class FileState {
+    Intact,
+    TornTail, // 末尾是崩溃时写了一半的记录
+    Damaged,  // 中间的记录损坏，或者不是变量文件
+};
+
+enum class RecordCheck { Valid, PastEnd, Invalid };
+
+// 检查 pos 处的记录：Valid 时 header 为其记录头，PastEnd 表示记录长度超出文件末尾
+RecordCheck check_record(const char* base, uint64_t size, uint64_t pos, RecordHeader& header) {
+    if (size - pos < sizeof(RecordHeader)) return RecordCheck::PastEnd;
+    std::memcpy(&header, base + pos, sizeof(header));
+    if (header.tag != RECORD_TAG || header.value_length > MAX_VALUE_LENGTH) return RecordCheck::Invalid;
+    uint64_t length = sizeof(RecordHeader) + header.key_length + header.value_length;
+    if (size - pos < length) return RecordCheck::PastEnd;
+    const char* key = base + pos + sizeof(RecordHeader);
+    if (record_checksum(header, key, key + header.key_length) != header.checksum) return RecordCheck::Invalid;
+    return RecordCheck::Valid;
+}
+
+/**
+ * 从文件头之后顺序读取记录，折叠为每个变量的最新一条（视图指向 base）。
+ * 无效记录之后再没有有效记录、且它的长度超出文件末尾时，是崩溃时写了一半的末尾记录；
+ * 其余情况说明文件已损坏，跳过损坏的部分，从下一条能通过校验的记录继续读
+ */
+FileState fold_records(const char* base, uint64_t size, std::unordered_map<std::string_view, Record>& latest,
+                       size_t& count) {
+    if (size < sizeof(FILE_MAGIC)) return FileState::Damaged;
+    FileState state = std::memcmp(base, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0 ? FileState::Intact : FileState::Damaged;
+    uint64_t pos = sizeof(FILE_MAGIC);
+    while (pos < size) {
+        RecordHeader header{};
+        RecordCheck check = check_record(base, size, pos, header);
+        if (check != RecordCheck::Valid) {
+            uint64_t next = pos + 1;
+            while (next < size && check_record(base, size, next, header) != RecordCheck::Valid) next++;
+            if (next >= size) {
+                return check == RecordCheck::PastEnd && state == FileState::Intact ? FileState::TornTail
+                                                                                   : FileState::Damaged;
+            }
+            state = FileState::Damaged;
+            pos = next;
+        }
+
+        uint64_t length = sizeof(RecordHeader) + header.key_length + header.value_length;
+        const char* key = base + pos + sizeof(RecordHeader);
+        const char* value = key + header.key_length;
+        Record record{std::string_view(key, header.key_length), std::string_view(value, header.value_length),
+                      header.type, header.flags, std::string_view(base + pos, length)};
+        latest[record.key] = record;
+        count++;
+        pos += length;
+    }
+    return state;
+}
+
+void append_u32(std::string& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void append_chunk(std::string& out, const std::string& chunk) {
+    append_u32(out, static_cast<uint32_t>(chunk.size()));
+    out += chunk;
+}
+
+// 值的二进制形式：整数为 8 字节，列表与映射为依次排列的“4 字节长度 + 内容”
+std::string encode_value(const Value& value) {
+    std::string payload;
+    int64_t integer = 0;
+    if (const std::string* text = value.string()) {
+        payload = *text;
+    }
+    else if (const Value::List* list = value.list()) {
+        for (const auto& item : *list) append_chunk(payload, item);
+    }
+    else if (const Value::Map* map = value.map()) {
+        for (const auto& [key, item] : *map) {
+            append_chunk(payload, key);
+            append_chunk(payload, item);
+        }
+    }
+    else if (value.as_integer(integer)) {
+        payload.assign(reinterpret_cast<const char*>(&integer), sizeof(integer));
+    }
+    return payload;
+}
+
+bool read_chunk(std::string_view& data, std::string_view& chunk) {
+    uint32_t length = 0;
+    if (data.size() < sizeof(length)) return false;
+    std::memcpy(&length, data.data(), sizeof(length));
+    data.remove_prefix(sizeof(length));
+    if (data.size() < length) return false;
+    chunk = data.substr(0, length);
+    data.remove_prefix(length);
+    return true;
+}
+
+bool decode_value(uint8_t type, std::string_view payload, Value& value) {
+    switch (static_cast<Value::Type>(type)) {
+    case Value::Type::String:
+        value = Value(std::string(payload));
+        return true;
+    case Value::Type::Integer: {
+        int64_t integer = 0;
+        if (payload.size() != sizeof(integer)) return false;
+        std::memcpy(&integer, payload.data(), sizeof(integer));
+        value = Value(integer);
+        return true;
+    }
+    case Value::Type::List: {
+        Value::List list;
+        std::string_view item;
+        while (!payload.empty()) {
+            if (!read_chunk(payload, item)) return false;
+            list.emplace_back(item);
+        }
+        value = Value(std::move(list));
+        return true;
+    }
+    case Value::Type::Map: {
+        Value::Map map;
+        std::string_view key;
+        std::string_view item;
+        while (!payload.empty()) {
+            if (!read_chunk(payload, key) || !read_chunk(payload, item)) return false;
+            map.emplace_back(key, item);
+        }
+        value = Value(std::move(map));
+        return true;
+    }
+    }
+    return false;
+}
+
+std::string encode_record(const std::string& name, uint8_t type, uint8_t flags, const std::string& payload) {
+    RecordHeader header{};
+    header.tag = RECORD_TAG;
+    header.value_length = static_cast<uint32_t>(payload.size());
+    header.key_length = static_cast<uint16_t>(name.size());
+    header.type = type;
+    header.flags = flags;
+    header.checksum = record_checksum(header, name.data(), payload.data());
+
+    std::string record(reinterpret_cast<const char*>(&header), sizeof(header));
+    record += name;
+    record += payload;
+    return record;
+}
+
+struct PersistState {
+    std::string file_path;
+    std::unordered_set<std::string> keys; // 文件中保存着的变量
+    size_t record_count = 0;              // 文件中的记录数（本会话所知）
+
+    const std::string& path() {
+        if (file_path.empty()) file_path = home_dir + "/duckshell/vars.db";
+        return file_path;
+    }
+
+    // 损坏的文件改名保存的位置
+    std::string corrupt_path() { return path() + ".corrupt"; }
+
+    // 读取文件内容并折叠，visit(latest, file_state) 中的视图只在回调期间有效
+    template <typename Visit>
+    bool read(Visit visit);
+
+    bool append(const std::string& record);
+
+    // 文件中保存着 name（可能是其他会话保存的）时追加它的删除记录，确认与追加在同一次加锁内完成
+    bool append_removal(const std::string& name, const std::string& record);
+
+    /**
+     * 重新读取文件，只保留每个变量的最新记录写成新文件替换原文件。
+     * set_aside 为假时是普通压缩，文件已损坏则不动它；为真时只处理已损坏的文件：原文件改名为 vars.db.corrupt
+     * 保留，新文件只含读出的有效记录。返回是否替换了文件
+     */
+    bool rewrite(bool set_aside);
+
+    void compact_if_needed() {
+        if (record_count >= MIN_COMPACT_RECORDS && record_count > keys.size() * 2) rewrite(false);
+    }
+};
+
+PersistState& persist_state() {
+    static PersistState state;
+    return state;
+}
+
+// 把折叠结果写成压缩后的文件内容，同时更新变量列表
+std::string compacted_contents(const std::unordered_map<std::string_view, Record>& latest, PersistState& state) {
+    std::string data(FILE_MAGIC, sizeof(FILE_MAGIC));
+    state.keys.clear();
+    for (const auto& [key, record] : latest) {
+        if (record.flags & FLAG_REMOVED) continue;
+        data.append(record.bytes.data(), record.bytes.size());
+        state.keys.emplace(key);
+    }
+    state.record_count = state.keys.size();
+    return data;
+}
+
+// 判断折叠结果中是否保存着 name
+bool is_saved(const std::unordered_map<std::string_view, Record>& latest, const std::string& name) {
+    auto it = latest.find(name);
+    return it != latest.end() && !(it->second.flags & FLAG_REMOVED);
+}
+
+#ifdef _WIN32
+
+bool read_file(const std::string& path, std::string& data) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+template <typename Visit>
+bool PersistState::read(Visit visit) {
+    std::string data;
+    if (!read_file(path(), data)) return false;
+    std::unordered_map<std::string_view, Record> latest;
+    size_t count = 0;
+    FileState file_state = data.empty() ? FileState::Intact : fold_records(data.data(), data.size(), latest, count);
+    record_count = count;
+    visit(latest, file_state);
+    return true;
+}
+
+bool PersistState::append(const std::string& record) {
+    std::ifstream exists(path(), std::ios::binary);
+    bool fresh = !exists || exists.peek() == std::ifstream::traits_type::eof();
+    exists.close();
+    std::ofstream out(path(), std::ios::binary | std::ios::app);
+    if (!out) return false;
+    if (fresh) out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    out.write(record.data(), static_cast<std::streamsize>(record.size()));
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+bool PersistState::append_removal(const std::string& name, const std::string& record) {
+    bool saved = false;
+    read([&](const std::unordered_map<std::string_view, Record>& latest, FileState) { saved = is_saved(latest, name); });
+    if (!saved) return true;
+    if (!append(record)) return false;
+    record_count++;
+    return true;
+}
+
+bool PersistState::rewrite(bool set_aside) {
+    std::string data;
+    bool damaged = false;
+    read([&](const std::unordered_map<std::string_view, Record>& latest, FileState file_state) {
+        damaged = file_state == FileState::Damaged;
+        data = compacted_contents(latest, *this);
+    });
+    if (data.empty() || damaged != set_aside) return false;
+    std::string temp_path = path() + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!out) return false;
+    }
+    if (set_aside) {
+        std::remove(corrupt_path().c_str());
+        if (std::rename(path().c_str(), corrupt_path().c_str()) != 0) {
+            std::remove(temp_path.c_str());
+            return false;
+        }
+    }
+    std::remove(path().c_str());
+    if (std::rename(temp_path.c_str(), path().c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+#else
+
+bool write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = ::write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void lock_file(int fd, int operation) {
+    while (flock(fd, operation) != 0 && errno == EINTR) {}
+}
+
+// 打开并锁住文件。加锁期间文件可能已被其他会话压缩替换，这时重新打开新的文件
+int open_locked(const std::string& path, int flags, int operation) {
+    for (int attempt = 0; attempt < 8; ++attempt) {
+        int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+        if (fd < 0) return -1;
+        lock_file(fd, operation);
+        struct stat opened{};
+        struct stat current{};
+        if (fstat(fd, &opened) == 0 && stat(path.c_str(), &current) == 0 && opened.st_ino == current.st_ino) return fd;
+        close(fd);
+    }
+    return -1;
+}
+
+// fd 已加锁时读取并折叠整个文件
+template <typename Visit>
+bool read_locked(int fd, size_t& record_count, Visit visit) {
+    struct stat info{};
+    if (fstat(fd, &info) != 0) return false;
+    auto size = static_cast<uint64_t>(info.st_size);
+    std::unordered_map<std::string_view, Record> latest;
+    if (size == 0) {
+        record_count = 0;
+        visit(latest, FileState::Intact);
+        return true;
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) return false;
+    const char* base = static_cast<const char*>(mapping);
+    size_t count = 0;
+    FileState file_state = fold_records(base, size, latest, count);
+    record_count = count;
+    visit(latest, file_state);
+    munmap(mapping, size);
+    return true;
+}
+
+template <typename Visit>
+bool PersistState::read(Visit visit) {
+    int fd = open_locked(path(), O_RDONLY, LOCK_SH);
+    if (fd < 0) return false;
+    bool ok = read_locked(fd, record_count, visit);
+    lock_file(fd, LOCK_UN);
+    close(fd);
+    return ok;
+}
+
+// 追加与读取、压缩互斥，读入时不会看到写了一半的记录
+bool PersistState::append(const std::string& record) {
+    int fd = open_locked(path(), O_WRONLY | O_APPEND | O_CREAT, LOCK_EX);
+    if (fd < 0) return false;
+    struct stat info{};
+    bool ok = fstat(fd, &info) == 0 && (info.st_size > 0 || write_all(fd, FILE_MAGIC, sizeof(FILE_MAGIC))) &&
+              write_all(fd, record.data(), record.size()) && fsync(fd) == 0;
+    lock_file(fd, LOCK_UN);
+    close(fd);
+    return ok;
+}
+
+bool PersistState::append_removal(const std::string& name, const std::string& record) {
+    int fd = open_locked(path(), O_RDWR | O_APPEND, LOCK_EX);
+    if (fd < 0) return errno == ENOENT; // 还没有保存过任何变量
+    bool saved = false;
+    bool ok = read_locked(fd, record_count, [&](const std::unordered_map<std::string_view, Record>& latest, FileState) {
+        saved = is_saved(latest, name);
+    });
+    if (ok && saved) {
+        ok = write_all(fd, record.data(), record.size()) && fsync(fd) == 0;
+        if (ok) record_count++;
+    }
+    lock_file(fd, LOCK_UN);
+    close(fd);
+    return ok;
+}
+
+// 在排他锁内重新读取文件（包括其他会话追加的记录），写临时文件后 rename 替换。
+// 要改名保存的损坏文件可能已经被其他会话处理过，以加锁后读到的状态为准
+bool PersistState::rewrite(bool set_aside) {
+    int fd = open_locked(path(), O_RDONLY, LOCK_EX);
+    if (fd < 0) return false;
+    std::string data;
+    bool damaged = false;
+    read_locked(fd, record_count, [&](const std::unordered_map<std::string_view, Record>& latest, FileState file_state) {
+        damaged = file_state == FileState::Damaged;
+        data = compacted_contents(latest, *this);
+    });
+
+    bool ok = false;
+    if (!data.empty() && damaged == set_aside) {
+        std::string temp_path = path() + ".tmp." + std::to_string(getpid());
+        int out = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ok = out >= 0 && write_all(out, data.data(), data.size()) && fsync(out) == 0 &&
+             (!set_aside || std::rename(path().c_str(), corrupt_path().c_str()) == 0) &&
+             std::rename(temp_path.c_str(), path().c_str()) == 0;
+        if (out >= 0) close(out);
+        if (!ok) unlink(temp_path.c_str());
+    }
+    lock_file(fd, LOCK_UN);
+    close(fd);
+    return ok;
+}
+
+#endif
+
+} // namespace
+
+void PersistentVars::load() {
+    PersistState& state = persist_state();
+    FileState found = FileState::Intact;
+    state.read([&](const std::unordered_map<std::string_view, Record>& latest, FileState file_state) {
+        found = file_state;
+        for (const auto& [key, record] : latest) {
+            Value value;
+            if ((record.flags & FLAG_REMOVED) || !decode_value(record.type, record.payload, value)) continue;
+            VariableStore::set(key, std::move(value));
+            state.keys.emplace(key);
+        }
+    });
+    switch (found) {
+    case FileState::Intact:
+        state.compact_if_needed();
+        break;
+    case FileState::TornTail:
+        // 立即压缩去掉写了一半的记录，之后追加的记录才能被读到
+        state.rewrite(false);
+        break;
+    case FileState::Damaged:
+        // 损坏的部分已经跳过，原文件保留下来而不是被压缩覆盖
+        if (state.rewrite(true)) {
+            println(RED << BOLD << "Saved variables file " << state.path() << " is damaged, moved it to "
+                        << state.corrupt_path() << RESET);
+        }
+        else {
+            println(RED << BOLD << "Saved variables file " << state.path() << " is damaged" << RESET);
+        }
+        break;
+    }
+}
+
+bool PersistentVars::store(const std::string& name, const Value& value) {
+    PersistState& state = persist_state();
+    std::string payload = encode_value(value);
+    if (name.empty() || name.size() > UINT16_MAX || payload.size() > MAX_VALUE_LENGTH) return false;
+    if (!state.append(encode_record(name, static_cast<uint8_t>(value.type()), 0, payload))) return false;
+    state.keys.insert(name);
+    state.record_count++;
+    state.compact_if_needed();
+    return true;
+}
+
+bool PersistentVars::remove(const std::string& name) {
+    PersistState& state = persist_state();
+    std::string record = encode_record(name, 0, FLAG_REMOVED, std::string());
+    if (state.keys.count(name) > 0) {
+        if (!state.append(record)) return false;
+        state.record_count++;
+    }
+    // 本会话不知道的变量也可能是其他会话保存的，要看过文件才能确定
+    else if (!state.append_removal(name, record)) {
+        return false;
+    }
+    state.keys.erase(name);
+    state.compact_if_needed();
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef PERSISTENT_VARS_H
+#define PERSISTENT_VARS_H
+
+#include <string>
+
+class Value;
+
+/**
+ * @brief 跨会话保存的变量（set -p）
+ *
+ * 变量保存在 ~/duckshell/vars.db，格式为只追加的日志：每次 set -p 或 unset 用一次 write 追加一条
+ * 带校验和的二进制记录并 fsync，文件本身就是预写日志。值按类型直接以二进制保存（整数为 8 字节，
+ * 列表与映射为带长度的元素序列），启动时 mmap 文件顺序走一遍记录头即可恢复，不需要解析文本。
+ *
+ * 崩溃时写了一半的末尾记录长度超出文件末尾，读入时丢弃，并立即压缩把它从文件中去掉。中间的记录校验和不符、
+ * 或者文件头不对时跳过损坏的部分，从下一条能通过校验的记录继续读；这时不做压缩，
+ * 原文件改名为 vars.db.corrupt 保留，新文件只含读出的有效记录。
+ * 记录数远多于变量数时压缩：只保留每个变量的最新记录写入临时文件，再 rename 替换原文件。
+ * 追加与压缩都持有排他锁、读取持有共享锁，多个会话可以同时使用同一个文件。
+ */
+class PersistentVars {
+public:
+    // 读入保存的变量，启动时调用一次
+    static void load();
+
+    // 保存变量的当前值，失败时返回 false
+    static bool store(const std::string& name, const Value& value);
+
+    // 不再保存该变量；没有保存过时什么也不做
+    static bool remove(const std::string& name);
+};
+
+#endif // PERSISTENT_VARS_H
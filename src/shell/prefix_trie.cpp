@@ -0,0 +1,82 @@
+#include <algorithm>
+
+#include "prefix_trie.h"
+
+void PrefixTrie::clear() {
+    nodes.clear();
+    nodes.emplace_back();
+    word_count = 0;
+}
+
+void PrefixTrie::insert(const std::string& word) {
+    uint32_t node = ROOT;
+    for (char c : word) {
+        auto& children = nodes[node].children;
+        auto it = std::lower_bound(children.begin(), children.end(), c,
+                                   [](const std::pair<char, uint32_t>& child, char key) { return child.first < key; });
+        if (it != children.end() && it->first == c) {
+            node = it->second;
+            continue;
+        }
+        auto next = static_cast<uint32_t>(nodes.size());
+        children.insert(it, {c, next});
+        nodes.emplace_back(); // 注意：会使 children 引用失效，之后不再使用
+        node = next;
+    }
+    if (!nodes[node].terminal) {
+        nodes[node].terminal = true;
+        word_count++;
+    }
+}
+
+uint32_t PrefixTrie::step(uint32_t node, char c) const {
+    if (node == NPOS) return NPOS;
+    const auto& children = nodes[node].children;
+    auto it = std::lower_bound(children.begin(), children.end(), c,
+                               [](const std::pair<char, uint32_t>& child, char key) { return child.first < key; });
+    if (it == children.end() || it->first != c) return NPOS;
+    return it->second;
+}
+
+uint32_t PrefixTrie::walk(uint32_t node, const std::string& text) const {
+    for (char c : text) {
+        node = step(node, c);
+        if (node == NPOS) break;
+    }
+    return node;
+}
+
+bool PrefixTrie::contains(const std::string& word) const {
+    uint32_t node = walk(ROOT, word);
+    return node != NPOS && nodes[node].terminal;
+}
+
+void PrefixTrie::collect(uint32_t node, const std::string& prefix, std::vector<std::string>& out, size_t limit) const {
+    if (node == NPOS) return;
+
+    // 显式栈上的深度优先遍历，子节点逆序入栈以保持字典序输出
+    struct Frame {
+        uint32_t node;
+        size_t depth; // 该节点对应单词的长度
+        char c;       // 从父节点到该节点的字符
+    };
+    std::vector<Frame> stack{{node, prefix.size(), '\0'}};
+    std::string word = prefix;
+    while (!stack.empty()) {
+        Frame frame = stack.back();
+        stack.pop_back();
+        if (frame.depth > prefix.size()) {
+            word.resize(frame.depth - 1);
+            word += frame.c;
+        }
+
+        if (nodes[frame.node].terminal) {
+            out.push_back(word);
+            if (limit != 0 && out.size() >= limit) return;
+        }
+        const auto& children = nodes[frame.node].children;
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            stack.push_back({it->second, frame.depth + 1, it->first});
+        }
+    }
+}
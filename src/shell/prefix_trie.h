@@ -0,0 +1,54 @@
+#ifndef PREFIX_TRIE_H
+#define PREFIX_TRIE_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 字符串前缀树
+ *
+ * 节点保存在连续数组中，子节点按字符排序，因此 collect() 的结果天然按字典序排列。
+ * 前缀每增加一个字符只需调用一次 step()，补全时可以沿着上一次的节点增量查找。
+ */
+class PrefixTrie {
+public:
+    static constexpr uint32_t NPOS = UINT32_MAX;
+    static constexpr uint32_t ROOT = 0;
+
+    PrefixTrie() { clear(); }
+
+    void clear();
+    void insert(const std::string& word);
+
+    // 单词数量（重复插入只计一次）
+    size_t size() const { return word_count; }
+
+    // 从 node 沿字符 c 前进一步，不存在时返回 NPOS
+    uint32_t step(uint32_t node, char c) const;
+
+    // 从 node 依次沿 text 中的字符前进
+    uint32_t walk(uint32_t node, const std::string& text) const;
+
+    // 是否包含完整的单词 word
+    bool contains(const std::string& word) const;
+
+    /**
+     * @brief 收集 node 之下的所有单词
+     * @param prefix node 对应的前缀，结果中的单词均以它开头
+     * @param limit 最多收集的数量，0 表示不限
+     */
+    void collect(uint32_t node, const std::string& prefix, std::vector<std::string>& out, size_t limit = 0) const;
+
+private:
+    struct Node {
+        std::vector<std::pair<char, uint32_t>> children;
+        bool terminal = false;
+    };
+
+    std::vector<Node> nodes;
+    size_t word_count = 0;
+};
+
+#endif // PREFIX_TRIE_H
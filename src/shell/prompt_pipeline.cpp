@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../header.h"
+#include "../plugins/plugin_common.h"
+#include "../plugins/plugins_interface.h"
+#include "prompt_pipeline.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// 使提示符段失效的事件
+enum PromptTrigger : unsigned {
+    CWD_CHANGED = 1u << 0,
+    COMMAND_EXECUTED = 1u << 1,
+    TIMER = 1u << 2, // 距上次计算超过 Segment::interval
+};
+
+// 显示提示符时等待后台段的最长时间，超过后先显示缓存的结果
+constexpr auto DEADLINE = std::chrono::milliseconds(30);
+// 插件段即使没有其他事件也定期重算，反映 shell 之外的变化（例如在别处修改了 git 仓库）
+constexpr auto PLUGIN_SEGMENT_TTL = std::chrono::seconds(10);
+
+struct Segment {
+    IPlugin* plugin = nullptr; // nullptr 为默认段，在主线程中直接计算
+    unsigned triggers = 0;
+    Clock::duration interval{};
+
+    std::string value;
+    bool valid = false;   // 缓存的 value 是否仍然有效
+    bool pending = false; // 已交给后台线程
+    uint64_t version = 0; // 每次失效加一，后台结果据此判断计算期间是否又失效了
+    Clock::time_point computed_at;
+};
+
+struct Job {
+    uint64_t epoch;
+    size_t index;
+    uint64_t version;
+};
+
+struct PipelineState {
+    std::mutex mutex; // 保护以下全部状态
+    std::condition_variable finished;
+    std::vector<Segment> segments;
+    std::vector<IPlugin*> plugins; // segments 建立时的插件列表，后台线程不读 loaded_plugin_instances
+    uint64_t epoch = 0;            // segments 每次重建加一，丢弃针对旧段的后台结果
+    unsigned events = 0;           // 尚未处理的事件
+    std::string cwd;
+    std::string shown;             // 最近一次交给输入循环的提示符
+
+    std::thread worker;
+    std::deque<Job> jobs;
+    std::condition_variable job_ready;
+    bool command_running = false; // 命令执行期间不开始新的计算
+    bool in_flight = false;       // 后台线程正在调用 get_prompt()
+    bool stopping = false;
+    int wake_pipe[2] = {-1, -1};
+
+    PipelineState() {
+#ifndef _WIN32
+        if (pipe(wake_pipe) == 0) {
+            for (int fd : wake_pipe) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+        }
+        else {
+            wake_pipe[0] = wake_pipe[1] = -1;
+        }
+#endif
+    }
+
+    ~PipelineState() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        job_ready.notify_all();
+        if (worker.joinable()) worker.join();
+#ifndef _WIN32
+        for (int fd : wake_pipe) {
+            if (fd >= 0) close(fd);
+        }
+#endif
+    }
+
+    void rebuild() {
+        segments.clear();
+        Segment base;
+        base.triggers = CWD_CHANGED;
+        segments.push_back(base);
+        for (IPlugin* plugin : loaded_plugin_instances) {
+            // 同一个插件可能以不同的名字登记了多次
+            bool seen = std::any_of(segments.begin(), segments.end(), [plugin](const Segment& s) { return s.plugin == plugin; });
+            if (seen) continue;
+            Segment segment;
+            segment.plugin = plugin;
+            segment.triggers = CWD_CHANGED | COMMAND_EXECUTED | TIMER;
+            segment.interval = PLUGIN_SEGMENT_TTL;
+            segments.push_back(segment);
+        }
+        plugins = loaded_plugin_instances;
+        epoch++;
+    }
+
+    // 第一个非空的插件段，没有时用默认段
+    std::string compose() const {
+        for (size_t i = 1; i < segments.size(); ++i) {
+            if (!segments[i].value.empty()) return segments[i].value;
+        }
+        return segments.front().value;
+    }
+
+    bool any_pending() const {
+        return std::any_of(segments.begin(), segments.end(), [](const Segment& s) { return s.pending; });
+    }
+
+    void schedule(size_t index) {
+        Segment& segment = segments[index];
+        segment.pending = true;
+        jobs.push_back(Job{epoch, index, segment.version});
+        if (!worker.joinable()) worker = std::thread([this]() { worker_loop(); });
+        job_ready.notify_one();
+    }
+
+    // 与原来一样只用第一个返回非空内容的插件：排在它之后的插件段不需要计算。
+    // 缓存的内容非空时认为它仍会非空，先不计算后面的段，等它算出空字符串再继续往后排
+    void schedule_plugins() {
+        if (command_running) return;
+        for (size_t i = 1; i < segments.size(); ++i) {
+            Segment& segment = segments[i];
+            if (!segment.valid && !segment.pending) schedule(i);
+            if (!segment.value.empty()) break;
+        }
+    }
+
+    void wake() {
+#ifndef _WIN32
+        if (wake_pipe[1] >= 0) {
+            char byte = 1;
+            (void)!write(wake_pipe[1], &byte, 1);
+        }
+#endif
+    }
+
+    void worker_loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            job_ready.wait(lock, [this]() { return stopping || (!command_running && !jobs.empty()); });
+            if (stopping) return;
+            Job job = jobs.front();
+            jobs.pop_front();
+            if (job.epoch != epoch) continue;
+            IPlugin* plugin = segments[job.index].plugin;
+            in_flight = true;
+            lock.unlock();
+
+            // 这时没有命令在执行，插件的命令与 get_prompt() 不会同时运行
+            std::string value = plugin->get_prompt();
+
+            lock.lock();
+            in_flight = false;
+            if (job.epoch != epoch) {
+                finished.notify_all();
+                continue;
+            }
+            Segment& segment = segments[job.index];
+            segment.value = std::move(value);
+            segment.pending = false;
+            if (segment.version == job.version) {
+                segment.valid = true;
+                segment.computed_at = Clock::now();
+            }
+            // 计算期间又失效了时先用这次的结果，由 schedule_plugins() 再算一次
+            schedule_plugins();
+            finished.notify_all();
+            wake();
+        }
+    }
+
+    std::string current() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (segments.empty() || plugins != loaded_plugin_instances) rebuild();
+
+        unsigned fired = events;
+        events = 0;
+        if (dir_now != cwd) {
+            cwd = dir_now;
+            fired |= CWD_CHANGED;
+        }
+
+        auto now = Clock::now();
+        for (Segment& segment : segments) {
+            bool expired = (segment.triggers & TIMER) && segment.valid && now - segment.computed_at >= segment.interval;
+            if ((segment.triggers & fired) || expired) {
+                segment.valid = false;
+                segment.version++;
+            }
+        }
+        Segment& base = segments.front();
+        if (!base.valid) {
+            base.value = std::string("DUCKSHELL { ") + dir_now + " }> ";
+            base.valid = true;
+            base.computed_at = now;
+        }
+        schedule_plugins();
+
+        finished.wait_until(lock, now + DEADLINE, [this]() { return !any_pending(); });
+        shown = compose();
+        return shown;
+    }
+
+    bool poll_update(std::string& prompt) {
+#ifndef _WIN32
+        char drain[64];
+        while (wake_pipe[0] >= 0 && read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+#endif
+        std::lock_guard<std::mutex> lock(mutex);
+        if (segments.empty()) return false;
+        std::string composed = compose();
+        if (composed == shown) return false;
+        shown = composed;
+        prompt = shown;
+        return true;
+    }
+};
+
+PipelineState& pipeline_state() {
+    static PipelineState state;
+    return state;
+}
+
+} // namespace
+
+std::string PromptPipeline::current() {
+    return pipeline_state().current();
+}
+
+void PromptPipeline::command_started() {
+    PipelineState& state = pipeline_state();
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.command_running = true;
+    state.finished.wait(lock, [&state]() { return !state.in_flight; });
+    // 排队的任务不再执行，对应的段留待下次显示提示符时重新安排
+    state.jobs.clear();
+    for (Segment& segment : state.segments) segment.pending = false;
+}
+
+void PromptPipeline::command_executed() {
+    PipelineState& state = pipeline_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.command_running = false;
+    state.events |= COMMAND_EXECUTED;
+    // 尽早丢弃针对已卸载插件的任务和结果
+    if (!state.segments.empty() && state.plugins != loaded_plugin_instances) {
+        state.jobs.clear();
+        state.rebuild();
+    }
+}
+
+bool PromptPipeline::poll_update(std::string& prompt) {
+    return pipeline_state().poll_update(prompt);
+}
+
+int PromptPipeline::wakeup_fd() {
+    return pipeline_state().wake_pipe[0];
+}
@@ -0,0 +1,39 @@
+#ifndef PROMPT_PIPELINE_H
+#define PROMPT_PIPELINE_H
+
+#include <string>
+
+/**
+ * @brief 提示符流水线
+ *
+ * 提示符由若干段组成：默认的 "DUCKSHELL { 目录 }> " 段和每个插件的 get_prompt() 段，
+ * 第一个返回非空内容的插件段取代默认段。每段缓存上一次的结果，并声明哪些事件使它失效
+ * （切换目录、执行命令、定时过期），只有失效的段才重新计算。
+ *
+ * 插件段可能很慢（例如调用 git），在后台线程中计算。显示提示符时最多等待一个很短的期限，
+ * 超时先显示缓存的结果，后台算完后由输入循环原地重绘提示符。
+ *
+ * 插件不要求线程安全，后台计算只在显示提示符、等待输入时进行：执行命令前丢弃排队的任务，
+ * 并等待正在进行的那一次 get_prompt() 返回，命令执行期间不开始新的计算。
+ * 插件实例在整个会话中不会被销毁（卸载只是从 loaded_plugin_instances 中移除），
+ * 插件列表每次变化都使段重建、代数加一，针对旧插件列表的后台结果直接丢弃。
+ */
+class PromptPipeline {
+public:
+    // 当前应显示的提示符
+    static std::string current();
+
+    // 执行命令前调用：丢弃排队的后台计算，等正在进行的计算完成后返回
+    static void command_started();
+
+    // 执行完一条命令后调用；命令加载或卸载了插件时在这里重建各段
+    static void command_executed();
+
+    // 后台计算完成后提示符是否有变化，有则通过 prompt 返回新的提示符
+    static bool poll_update(std::string& prompt);
+
+    // 后台计算完成时变为可读的文件描述符，输入循环与终端输入一起等待；Windows 下返回 -1
+    static int wakeup_fd();
+};
+
+#endif // PROMPT_PIPELINE_H
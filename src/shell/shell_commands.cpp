@@ -5,13 +5,23 @@
 #include <utility>
 #include <vector>
 #include <sstream>
-#include <regex>
 #include <cstring>
 
 #include "../header.h"
 #include "../plugins/plugin_manager.h"
+#include "arithmetic.h"
+#include "shell_fileops.h"
+#include "shell_listing.h"
+#include "shell_navigation.h"
+#include "dir_cache.h"
+#include "persistent_vars.h"
+#include "shell_watch.h"
+#include "terminal_session.h"
+#include "variable_expansion.h"
+#include "variable_store.h"
 
 #ifndef _WIN32
+#include <cerrno>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -79,6 +89,7 @@ int execute_external_command(const std::vector<std::string>& args) {
     pid_t pid = fork();
     if (pid == 0) {
         // 子进程
+        TerminalSession::prepare_child();
         std::vector<char*> c_args;
         for (const auto& arg : args) {
             c_args.push_back(const_cast<char*>(arg.c_str()));
@@ -88,11 +99,14 @@ int execute_external_command(const std::vector<std::string>& args) {
         execvp(c_args[0], c_args.data());
         // 如果 execvp 返回，说明执行失败
         std::cerr << "DuckShell: failed to execute " << c_args[0] << ": " << strerror(errno) << std::endl;
-        exit(127);
+        // 使用 _exit，避免在子进程中执行父进程的静态析构（如后台线程的 join）
+        _exit(127);
     } else if (pid > 0) {
         // 父进程
         int status;
-        waitpid(pid, &status, 0);
+        while (waitpid(pid, &status, 0) < 0) {
+            if (errno != EINTR) return -1;
+        }
         if (WIFEXITED(status)) {
             return WEXITSTATUS(status);
         }
@@ -104,68 +118,6 @@ int execute_external_command(const std::vector<std::string>& args) {
 #endif
 }
 
-// 辅助函数：处理字符串变换逻辑，如 .replace()
-std::string transform_string(std::string text) {
-    // 处理变量替换 ${var} 或 ${var.replace("old", "new")}
-    const std::regex var_regex(R"(\$\{([^}]+)\})");
-    std::smatch match;
-    std::string result = std::move(text);
-
-    while (std::regex_search(result, match, var_regex)) {
-        std::string expression = match[1].str();
-        std::string replacement;
-
-        // 检查是否有 .replace() 调用
-        size_t dot_pos = expression.find(".replace(");
-        if (dot_pos != std::string::npos) {
-            std::string var_name = expression.substr(0, dot_pos);
-            std::string call = expression.substr(dot_pos + 9); // 去掉 ".replace("
-            
-            // 简单解析参数，例如 "old", "new")
-            size_t comma_pos = call.find(',');
-            size_t end_paren = call.find(')');
-            
-            if (comma_pos != std::string::npos && end_paren != std::string::npos) {
-                std::string old_str = call.substr(0, comma_pos);
-                std::string new_str = call.substr(comma_pos + 1, end_paren - comma_pos - 1);
-                
-                // 移除可能的引号
-                auto clean = [](std::string s) {
-                    s.erase(std::remove(s.begin(), s.end(), '\"'), s.end());
-                    s.erase(std::remove(s.begin(), s.end(), '\''), s.end());
-                    // 移除首尾空白
-                    size_t f = s.find_first_not_of(' ');
-                    size_t l = s.find_last_not_of(' ');
-                    if (f != std::string::npos && l != std::string::npos) return s.substr(f, l - f + 1);
-                    return s;
-                };
-                
-                old_str = clean(old_str);
-                new_str = clean(new_str);
-                
-                std::string base_val = shell_global_vars.count(var_name) ? shell_global_vars[var_name] : "";
-                
-                // 执行替换
-                if (!old_str.empty()) {
-                    size_t start_pos = 0;
-                    while((start_pos = base_val.find(old_str, start_pos)) != std::string::npos) {
-                        base_val.replace(start_pos, old_str.length(), new_str);
-                        start_pos += new_str.length();
-                    }
-                }
-                replacement = base_val;
-            }
-        } else {
-            // 普通变量替换
-            replacement = shell_global_vars.count(expression) ? shell_global_vars[expression] : "";
-        }
-
-        result.replace(match.position(0), match.length(0), replacement);
-    }
-
-    return result;
-}
-
 int execute_command(const std::string& input) {
     // 移除首尾空白符及不可见的 \r 等
     std::string trimmed = input;
@@ -174,8 +126,12 @@ int execute_command(const std::string& input) {
     size_t end = trimmed.find_last_not_of(" \t\n\r");
     trimmed = trimmed.substr(start, end - start + 1);
 
-    // 应用全局变量替换和字符串转换逻辑 (如 .replace())
-    std::string transformed = transform_string(trimmed);
+    // 先计算 $(( ))，其中的变量直接按名字引用
+    if (!Arithmetic::expand(trimmed)) return 1;
+
+    // 应用全局变量替换和字符串方法 (如 .replace())
+    std::string transformed = std::move(trimmed);
+    if (!VariableExpansion::expand(transformed)) return 1;
     
     if (const std::vector<std::string> cmd_inner = split(transformed, ' '); cmd_inner.empty()) return 1;
     const std::vector<std::string> cmd = split(transformed, ' ');
@@ -211,223 +167,39 @@ int execute_command(const std::string& input) {
             return 0;
         }
 
-        std::string new_path;
-        std::string path_separator;
-#ifdef _WIN32
-        path_separator = "\\";
-        // Check if it's an absolute path (e.g., "C:\", "D:\")
-        if (cmd[1].length() >= 2 && cmd[1][1] == ':') {
-            new_path = cmd[1];
-        }
-#else
-        path_separator = "/";
-        if (cmd[1][0] == '/') {
-            // Absolute path in Unix
-            new_path = cmd[1];
-        }
-#endif
-        else {
-            // Relative path
-            if (cmd[1] == "..") {
-                size_t last_sep = dir_now.find_last_of("/\\");
-                if (last_sep != std::string::npos && last_sep > 0) {
-                    new_path = dir_now.substr(0, last_sep);
-                    // Keep drive letter for Windows
-#ifdef _WIN32
-                    if (new_path.length() == 2 && new_path[1] == ':') {
-                        new_path += path_separator;
-                    }
-#endif
-                } else {
-#ifdef _WIN32
-                    new_path = "C:";
-#else
-                    new_path = "/";
-#endif
-                }
-            }
-            else if (cmd[1] == ".") {
-                new_path = dir_now;
-            }
-            else {
-                // Handle path concatenation
-                if (dir_now.back() == '/' || dir_now.back() == '\\') {
-                    new_path = dir_now + cmd[1];
-                }
-                else {
-                    new_path = dir_now + path_separator + cmd[1];
-                }
-            }
-        }
-
-        // Normalize path separators for the current platform
-        std::replace(new_path.begin(), new_path.end(), '/', path_separator[0]);
-        std::replace(new_path.begin(), new_path.end(), '\\', path_separator[0]);
-
-        // Canonicalize path to remove "." and ".." segments and produce a full path style
-        auto normalize_path = [&](const std::string &p) -> std::string {
-            if (p.empty()) return p;
-
-            const char sep = path_separator[0];
-            std::vector<std::string> segments;
-
-            // Detect Windows drive like "C:" and whether rooted (e.g., C:\)
-            std::string drivePrefix;
-            bool rooted = false;
+        return change_directory(cmd[1]);
+    }
 
-#ifdef _WIN32
-            if (p.size() >= 2 && p[1] == ':') {
-                drivePrefix = p.substr(0, 2); // e.g., "C:"
-                // Check if after drive there is a separator -> rooted at drive
-                if (p.size() >= 3 && (p[2] == '\\' || p[2] == '/')) {
-                    rooted = true;
-                }
-            } else if (!p.empty() && (p[0] == '\\' || p[0] == '/')) {
-                rooted = true;
-            }
-#else
-            if (!p.empty() && p[0] == '/') {
-                rooted = true;
-            }
-#endif
+    else if (cmd[0] == "pushd") {
+        return builtin_pushd(cmd);
+    }
 
-            // Split by both separators
-            std::string token;
-            auto flush_token = [&]() {
-                if (!token.empty()) {
-                    if (token == ".") {
-                        // skip
-                    }
-                    else if (token == "..") {
-                        if (!segments.empty()) {
-                            segments.pop_back();
-                        } else {
-                            // At root: keep as root, ignore further ".."
-                        }
-                    }
-                    else {
-                        segments.emplace_back(token);
-                    }
-                    token.clear();
-                }
-            };
+    else if (cmd[0] == "popd") {
+        return builtin_popd(cmd);
+    }
 
-            for (size_t i = 0; i < p.size(); ++i) {
-                char c = p[i];
-                if (c == '/' || c == '\\') {
-                    flush_token();
-                }
-                else {
-                    // Skip drive letters already captured
-#ifdef _WIN32
-                    if (i < 2 && p.size() >= 2 && p[1] == ':') {
-                        // part of drive, skip storing
-                        continue;
-                    }
-                    if (i == 2 && p.size() >= 3 && (p[2] == '\\' || p[2] == '/')) {
-                        // skip the separator after drive when rooted
-                        continue;
-                    }
-#endif
-                    token.push_back(c);
-                }
-            }
-            flush_token();
+    else if (cmd[0] == "dirs") {
+        return builtin_dirs(cmd);
+    }
 
-            // Rebuild
-            std::string result;
-#ifdef _WIN32
-            result += drivePrefix;
-#endif
-            if (rooted) result.push_back(sep);
-            for (const auto & segment : segments) {
-                if (!(result.empty() || result.back() == sep)) {
-                    result.push_back(sep);
-                }
-                result += segment;
-            }
+    else if (cmd[0] == "j") {
+        return builtin_jump(cmd);
+    }
 
-#ifdef _WIN32
-            // Ensure a root like "C:" becomes "C:\" to match previous behavior
-            if (!drivePrefix.empty() && rooted && segments.empty()) {
-                if (result.size() == 2) result.push_back(sep);
-            }
-#endif
-            return result;
-        };
+    else if (cmd[0] == "ls" || cmd[0] == "dir" || cmd[0] == "ListFiles") {
+        return builtin_list(cmd);
+    }
 
-        new_path = normalize_path(new_path);
+    else if (cmd[0] == "cache") {
+        return builtin_cache(cmd);
+    }
 
-            if (is_directory_exists(new_path)) {
-#ifdef _WIN32
-                // On Windows, correct the case of each path component and uppercase drive letter
-                // using WinAPI. This ensures paths like "c:\windows" or "C:\WINDOWS" display as
-                // "C:\Windows" consistently.
-                #ifndef MAX_PATH
-                #define MAX_PATH 260
-                #endif
-                char fullBuf[MAX_PATH];
-                DWORD flen = GetFullPathNameA(new_path.c_str(), MAX_PATH, fullBuf, nullptr);
-                std::string full = (flen > 0 && flen < MAX_PATH) ? std::string(fullBuf, flen) : new_path;
-
-                char longBuf[MAX_PATH];
-                DWORD llen = GetLongPathNameA(full.c_str(), longBuf, MAX_PATH);
-                std::string cased = (llen > 0 && llen < MAX_PATH) ? std::string(longBuf, llen) : full;
-
-                if (!cased.empty() && std::isalpha(static_cast<unsigned char>(cased[0]))) {
-                    cased[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(cased[0])));
-                }
-                dir_now = cased;
-#else
-                dir_now = new_path;
-#endif
-            }
-            else {
-                println(RED << BOLD << "Directory does not exist." << RESET);
-            }
-        }
+    else if (cmd[0] == "watch") {
+        return builtin_watch(cmd);
+    }
 
-    else if (cmd[0] == "ls" || cmd[0] == "dir" || cmd[0] == "ListFiles") {
-#ifdef _WIN32
-        try {
-            std::string searchPath = dir_now + "\\*";
-            WIN32_FIND_DATAA findData;
-            HANDLE hFind = FindFirstFileA(searchPath.c_str(), &findData);
-
-            if (hFind != INVALID_HANDLE_VALUE) {
-                do {
-                    std::string name(findData.cFileName);
-                    std::string type = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? "<DIR>   " : "<FILE>  ";
-                    std::cout << std::left << std::setw(6) << type
-                             << " " << name << std::endl;
-                }
-                while (FindNextFileA(hFind, &findData));
-                FindClose(hFind);
-            }
-        }
-        catch (...) {
-            std::cerr << RED << BOLD << "Error accessing directory." << RESET << std::endl;
-        }
-#else
-        // Linux/Unix 实现
-        DIR* dir = opendir(dir_now.c_str());
-        if (dir) {
-            struct dirent* entry;
-            while ((entry = readdir(dir)) != nullptr) {
-                std::string name(entry->d_name);
-                if (name != "." && name != "..") {
-                    struct stat statbuf;
-                    std::string fullPath = dir_now + "/" + name;
-                    if (stat(fullPath.c_str(), &statbuf) == 0) {
-                        std::string type = S_ISDIR(statbuf.st_mode) ? "<DIR>   " : "<FILE>  ";
-                        std::cout << std::left << std::setw(6) << type
-                                 << " " << name << std::endl;
-                    }
-                }
-            }
-            closedir(dir);
-        }
-#endif
+    else if (cmd[0] == "on-change") {
+        return builtin_on_change(cmd);
     }
 
     // 在 execute 函数中添加插件管理命令处理
@@ -681,54 +453,21 @@ int execute_command(const std::string& input) {
     // 文件系统操作
     // 删除物品
     else if (cmd[0] == "rmv" || cmd[0] == "rm" || cmd[0] == "RemoveItem" || cmd[0] == "del") {
-        if (cmd.size() < 2) {
-            println("Usage: { rm | rmv | RemoveItem | del } [options] <filename>\n");
-            return 1;
-        }
+        return builtin_remove(cmd);
+    }
 
-        std::string filepath;
-        if (cmd[1][0] == '/' || (cmd[1].length() >= 2 && cmd[1][1] == ':')) {
-            // Absolute path
-            filepath = cmd[1];
-        } else {
-            // Relative path
-            filepath = dir_now +
-#ifdef _WIN32
-                       "\\" +
-#else
-                       "/" +
-#endif
-                       cmd[1];
-        }
+    // 复制与移动
+    else if (cmd[0] == "cp" || cmd[0] == "copy" || cmd[0] == "CopyItem") {
+        return builtin_copy(cmd);
+    }
 
-#ifdef _WIN32
-        if (DeleteFileA(filepath.c_str()) == 0) {
-            println(RED << BOLD << "Failed to delete file: " << filepath << RESET);
-        } else {
-            println(GREEN << "File deleted successfully: " << filepath << RESET);
-        }
-#else
-        if (unlink(filepath.c_str()) != 0) {
-            println(RED << BOLD << "Failed to delete file: " << filepath << RESET);
-        } else {
-            println(GREEN << "File deleted successfully: " << filepath << RESET);
-        }
-#endif
+    else if (cmd[0] == "mv" || cmd[0] == "move" || cmd[0] == "MoveItem") {
+        return builtin_move(cmd);
     }
 
     // 新建物品
     else if (cmd[0] == "new" || cmd[0] == "crt" || cmd[0] == "mk") {
-        if (cmd.size() < 2) {
-            println("Usage: { new | crt | mk } [options] <name>\n"
-                  "Options:\n"
-                  "    -f      Create a file.\n"
-                  "    -d      Create a directory.");
-            return 1;
-        }
-        else {
-            println(YELLOW << "Feature not fully implemented yet." << RESET);
-            return 0;
-        }
+        return builtin_create(cmd);
     }
 
     // 经典echo命令
@@ -757,18 +496,41 @@ int execute_command(const std::string& input) {
 
     // set命令，用于设置变量
     else if (cmd[0] == "set" || cmd[0] == "var") {
-        if (cmd.size() < 2) {
-            println(RED << BOLD << "Missing arguments. Usage: set key=value" << RESET);
+        // set -p 同时把变量保存到 ~/duckshell/vars.db，之后的会话启动时自动读入
+        bool persist = cmd.size() > 1 && cmd[1] == "-p";
+        size_t arg = persist ? 2 : 1;
+        if (cmd.size() <= arg) {
+            println(RED << BOLD << "Missing arguments. Usage: set [-p] key=value" << RESET);
         }
         else {
-            size_t pos = cmd[1].find('=');
+            size_t pos = cmd[arg].find('=');
             if (pos != std::string::npos) {
-                std::string key = cmd[1].substr(0, pos);
-                std::string value = cmd[1].substr(pos + 1);
-                shell_global_vars[key] = value;
+                // 值按写法解析为整数、列表 [a,b] 或映射 {k:v}，其余为字符串
+                std::string_view assignment = cmd[arg];
+                VariableStore::Symbol symbol = VariableStore::intern(assignment.substr(0, pos));
+                VariableStore::set(symbol, Value::parse(assignment.substr(pos + 1)));
                 // println(GREEN << "Variable set: " << key << " = " << value << RESET);
+                if (persist && !PersistentVars::store(VariableStore::name(symbol), *VariableStore::get(symbol))) {
+                    println(RED << BOLD << "Failed to save variable " << VariableStore::name(symbol) << RESET);
+                    return 1;
+                }
             } else {
-                println(RED << BOLD << "Invalid format. Usage: set key=value" << RESET);
+                println(RED << BOLD << "Invalid format. Usage: set [-p] key=value" << RESET);
+            }
+        }
+    }
+
+    // unset 删除变量，保存过的变量也从 vars.db 中删除
+    else if (cmd[0] == "unset") {
+        if (cmd.size() < 2) {
+            println(RED << BOLD << "Missing arguments. Usage: unset key..." << RESET);
+            return 1;
+        }
+        for (size_t i = 1; i < cmd.size(); ++i) {
+            VariableStore::unset(VariableStore::intern(cmd[i]));
+            if (!PersistentVars::remove(cmd[i])) {
+                println(RED << BOLD << "Failed to remove saved variable " << cmd[i] << RESET);
+                return 1;
             }
         }
     }
@@ -778,6 +540,8 @@ int execute_command(const std::string& input) {
         // 提取参数 (去掉命令名本身)
         std::vector<std::string> args(cmd.begin() + 1, cmd.end());
         PluginManager::executeCommand(cmd[0], args);
+        VariableStore::sync_from_view();
+        DirCache::sync();
         return 0;
     }
 
@@ -789,6 +553,7 @@ int execute_command(const std::string& input) {
         // 使用自定义的执行函数代替 system()
         // system() 会调用 cmd.exe /c，而 execute_external_command 直接启动进程
         int result = execute_external_command(cmd);
+        DirCache::sync();
 
         // 确保子进程的所有输出都已经打印出来
         std::cout.flush();
@@ -806,7 +571,7 @@ int execute_command(const std::string& input) {
                 println(RED << BOLD << "DuckShell: COMMAND NOT FOUND! Please specify another command." << RESET);
             }
 #endif
-            return 127;
+            return result < 0 ? 127 : result;
         }
     }
     return 0;
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <unordered_set>
+
+#include "../header.h"
+#include "../plugins/plugin_manager.h"
+#include "dir_cache.h"
+#include "prefix_trie.h"
+#include "shell_completion.h"
+#include "shell_path.h"
+
+// execute_command 中直接处理的命令
+static const char* const BUILTIN_COMMANDS[] = {
+    "cache", "cd", "clear", "cls", "copy", "CopyItem", "cp", "crt", "del", "dir", "dirs", "echo", "exit",
+    "j", "ListFiles", "ls", "mk", "move", "MoveItem", "mv", "new", "on-change", "plugin", "plugins", "popd",
+    "print", "pushd", "quit", "RemoveItem", "rm", "rmv", "set", "unset", "var", "watch",
+};
+
+/**
+ * @brief 命令名索引：内置命令、插件别名和 PATH 中的可执行文件
+ *
+ * PATH 目录通过 DirCache 读取，目录未变化时命中缓存不产生系统调用；
+ * 任意一个目录的列表对象变化（或 PATH、插件表变化）时才重建前缀树。
+ */
+struct CommandIndex {
+    PrefixTrie trie;
+    uint64_t generation = 0;
+    std::string path_value;
+    std::map<std::string, std::string> plugin_commands;
+    std::vector<std::shared_ptr<const DirListing>> path_listings;
+
+    static std::vector<std::string> path_directories(const std::string& value) {
+#ifdef _WIN32
+        const char delimiter = ';';
+#else
+        const char delimiter = ':';
+#endif
+        std::vector<std::string> dirs;
+        size_t start = 0;
+        while (start <= value.size()) {
+            size_t end = value.find(delimiter, start);
+            if (end == std::string::npos) end = value.size();
+            if (end > start) dirs.push_back(value.substr(start, end - start));
+            start = end + 1;
+        }
+        return dirs;
+    }
+
+    static bool is_executable(const DirEntryInfo& entry) {
+#ifdef _WIN32
+        size_t dot = entry.name.find_last_of('.');
+        if (dot == std::string::npos || entry.type == EntryType::Directory) return false;
+        std::string ext = entry.name.substr(dot);
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+        return ext == ".exe" || ext == ".bat" || ext == ".cmd" || ext == ".com";
+#else
+        // 符号链接不跟随检查，几乎所有 PATH 中的链接都指向可执行文件
+        if (entry.type == EntryType::Symlink) return true;
+        return entry.type == EntryType::File && (entry.mode & 0111) != 0;
+#endif
+    }
+
+    void refresh() {
+        const char* env = std::getenv("PATH");
+        std::string current_path = env ? env : "";
+        const auto& plugins = PluginLoader::command_to_plugin_map();
+
+        std::vector<std::shared_ptr<const DirListing>> listings;
+        for (const auto& dir : path_directories(current_path)) {
+            if (auto listing = DirCache::get(dir, true)) listings.push_back(std::move(listing));
+        }
+
+        if (generation != 0 && current_path == path_value && plugins == plugin_commands && listings == path_listings) {
+            return;
+        }
+
+        trie.clear();
+        for (const char* name : BUILTIN_COMMANDS) trie.insert(name);
+        for (const auto& [alias, plugin] : plugins) trie.insert(alias);
+        for (const auto& listing : listings) {
+            for (const auto& entry : *listing) {
+                if (is_executable(entry)) trie.insert(entry.name);
+            }
+        }
+
+        path_value = std::move(current_path);
+        plugin_commands = plugins;
+        path_listings = std::move(listings);
+        generation++;
+    }
+};
+
+// 单行输入内的补全状态，前缀变长时在上一次结果的基础上继续
+struct CompletionSession {
+    // 命令补全：上一次前缀及其在前缀树中的节点
+    uint64_t command_generation = 0;
+    std::string command_prefix;
+    uint32_t command_node = PrefixTrie::NPOS;
+
+    // 文件名补全：上一次的目录与匹配到的目录项
+    bool has_files = false;
+    std::string file_dir;
+    std::string file_prefix;
+    std::vector<const DirEntryInfo*> file_matches;
+    std::shared_ptr<const DirListing> file_listing;
+};
+
+static CommandIndex& command_index() {
+    static CommandIndex index;
+    return index;
+}
+
+static CompletionSession session;
+
+void reset_completion_session() {
+    session = CompletionSession{};
+}
+
+void refresh_command_index() {
+    command_index().refresh();
+}
+
+CommandKind lookup_command(const std::string& name) {
+    static const std::unordered_set<std::string> builtins(std::begin(BUILTIN_COMMANDS), std::end(BUILTIN_COMMANDS));
+    if (name.empty()) return CommandKind::Unknown;
+
+    if (name.find_first_of("/\\") != std::string::npos) {
+        std::string path = resolve_path(name);
+        auto listing = DirCache::get(path_dirname(path), true);
+        if (!listing) return CommandKind::Unknown;
+        std::string base = path_basename(path);
+        auto it = std::find_if(listing->begin(), listing->end(),
+                               [&](const DirEntryInfo& entry) { return entry.name == base; });
+        return it != listing->end() && CommandIndex::is_executable(*it) ? CommandKind::External : CommandKind::Unknown;
+    }
+
+    if (builtins.count(name)) return CommandKind::Builtin;
+    const CommandIndex& index = command_index();
+    if (index.plugin_commands.count(name)) return CommandKind::Plugin;
+    return index.trie.contains(name) ? CommandKind::External : CommandKind::Unknown;
+}
+
+std::string longest_common_prefix(const std::vector<std::string>& words) {
+    if (words.empty()) return "";
+    std::string prefix = words.front();
+    for (const auto& word : words) {
+        size_t n = 0;
+        while (n < prefix.size() && n < word.size() && prefix[n] == word[n]) n++;
+        prefix.resize(n);
+    }
+    // 不在多字节字符中间截断
+    while (!prefix.empty() && prefix.size() < words.front().size() &&
+           (static_cast<unsigned char>(words.front()[prefix.size()]) & 0xC0) == 0x80) {
+        prefix.pop_back();
+    }
+    return prefix;
+}
+
+static void complete_command(const std::string& word, std::vector<std::string>& out) {
+    CommandIndex& index = command_index();
+    index.refresh();
+
+    // 前缀在上一次的基础上变长时，只需从上一次的节点继续走新增的字符
+    uint32_t node;
+    if (session.command_generation == index.generation && session.command_node != PrefixTrie::NPOS &&
+        word.compare(0, session.command_prefix.size(), session.command_prefix) == 0) {
+        node = index.trie.walk(session.command_node, word.substr(session.command_prefix.size()));
+    }
+    else {
+        node = index.trie.walk(PrefixTrie::ROOT, word);
+    }
+
+    session.command_generation = index.generation;
+    session.command_prefix = word;
+    session.command_node = node;
+    index.trie.collect(node, word, out);
+}
+
+static void complete_file(const std::string& word, std::vector<std::string>& out) {
+    size_t sep = word.find_last_of("/\\");
+    std::string dir_part = sep == std::string::npos ? "" : word.substr(0, sep + 1);
+    std::string base = sep == std::string::npos ? word : word.substr(sep + 1);
+    std::string dir = dir_part.empty() ? dir_now : resolve_path(dir_part);
+
+    // 从空前缀变为以 . 开头时需要重新读取，之前的结果里没有隐藏文件
+    bool reveals_hidden = session.file_prefix.empty() && !base.empty() && base[0] == '.';
+    if (session.has_files && session.file_dir == dir && !reveals_hidden &&
+        base.compare(0, session.file_prefix.size(), session.file_prefix) == 0) {
+        // 前缀变长：只过滤上一次的匹配结果，不再读取目录
+        auto& matches = session.file_matches;
+        matches.erase(std::remove_if(matches.begin(), matches.end(),
+                                     [&](const DirEntryInfo* entry) {
+                                         return entry->name.compare(0, base.size(), base) != 0;
+                                     }),
+                      matches.end());
+    }
+    else {
+        session.file_listing = DirCache::get(dir, false);
+        session.file_matches.clear();
+        if (session.file_listing) {
+            bool show_hidden = !base.empty() && base[0] == '.';
+            for (const auto& entry : *session.file_listing) {
+                if (!show_hidden && !entry.name.empty() && entry.name[0] == '.') continue;
+                if (entry.name.compare(0, base.size(), base) == 0) session.file_matches.push_back(&entry);
+            }
+            std::sort(session.file_matches.begin(), session.file_matches.end(),
+                      [](const DirEntryInfo* a, const DirEntryInfo* b) { return a->name < b->name; });
+        }
+        session.has_files = true;
+        session.file_dir = dir;
+    }
+    session.file_prefix = base;
+
+    for (const auto* entry : session.file_matches) {
+        bool is_dir = entry->type == EntryType::Directory;
+        if (entry->type == EntryType::Symlink || entry->type == EntryType::Unknown) {
+            is_dir = is_directory_exists(path_join(dir, entry->name));
+        }
+        out.push_back(dir_part + entry->name + (is_dir ? std::string(1, PATH_SEPARATOR) : ""));
+    }
+}
+
+Completion complete_word(const std::string& buffer, size_t cursor) {
+    Completion result;
+    cursor = std::min(cursor, buffer.size());
+    result.word_start = cursor;
+    while (result.word_start > 0 && buffer[result.word_start - 1] != ' ') result.word_start--;
+    result.word = buffer.substr(result.word_start, cursor - result.word_start);
+
+    bool first_word = buffer.find_first_not_of(' ') >= result.word_start;
+    bool looks_like_path = result.word.find_first_of("/\\") != std::string::npos ||
+                           (!result.word.empty() && (result.word[0] == '.' || result.word[0] == '~'));
+
+    if (first_word && !looks_like_path) complete_command(result.word, result.candidates);
+    else complete_file(result.word, result.candidates);
+    return result;
+}
@@ -0,0 +1,49 @@
+#ifndef SHELL_COMPLETION_H
+#define SHELL_COMPLETION_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 一次 Tab 补全的结果
+ *
+ * candidates 中是完整的替换文本：目录以分隔符结尾，文件名带有用户已输入的目录部分。
+ */
+struct Completion {
+    size_t word_start = 0; // 被补全的词在输入缓冲区中的起始位置
+    std::string word;      // 光标前已输入的部分
+    std::vector<std::string> candidates;
+};
+
+/**
+ * @brief 补全光标前的词
+ *
+ * 第一个词在内置命令、插件命令和 PATH 中的可执行文件中查找，其余的词按文件名补全。
+ * 同一行内前缀继续变长时沿用上一次的结果增量过滤，不会重新扫描。
+ */
+Completion complete_word(const std::string& buffer, size_t cursor);
+
+// 开始新的一行输入时调用，丢弃上一行的补全状态
+void reset_completion_session();
+
+enum class CommandKind {
+    Unknown,
+    Builtin,  // execute_command 中直接处理的命令
+    Plugin,   // 插件注册的命令别名
+    External, // PATH 中（或按路径给出）的可执行文件
+};
+
+// 按需重建命令名索引（PATH、插件表或 PATH 目录内容变化时），每行输入开始时调用一次
+void refresh_command_index();
+
+/**
+ * @brief 命令名的类别，供输入时的语法高亮使用
+ *
+ * 只查询内存中的索引，不会对每次查询都 stat；带路径的命令在 DirCache 缓存的目录列表中查找。
+ */
+CommandKind lookup_command(const std::string& name);
+
+std::string longest_common_prefix(const std::vector<std::string>& words);
+
+#endif // SHELL_COMPLETION_H
@@ -0,0 +1,1197 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "../header.h"
+#include "shell_fileops.h"
+#include "dir_cache.h"
+#include "shell_path.h"
+#include "worker_pool.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>   // FICLONE
+#endif
+
+#ifdef __APPLE__
+#define STAT_ATIME(st) (st).st_atimespec
+#define STAT_MTIME(st) (st).st_mtimespec
+#else
+#define STAT_ATIME(st) (st).st_atim
+#define STAT_MTIME(st) (st).st_mtim
+#endif
+
+// 文件操作统计信息，由工作线程并发更新
+struct FileOpStats {
+    std::atomic<uint64_t> files{0};
+    std::atomic<uint64_t> dirs{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> reflinks{0};
+    std::atomic<uint64_t> skipped{0}; // -n 时因目标已存在而跳过的文件
+
+    std::mutex error_mutex;
+    std::vector<std::string> errors;
+
+    void add_error(const std::string& message) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        errors.push_back(message);
+    }
+};
+
+struct FileOpOptions {
+    bool recursive = false;
+    bool no_clobber = false;
+    bool preserve = false;
+    bool force = false;
+    bool directory = false;
+    bool parents = false;
+    uint64_t size = 0;
+};
+
+static std::string format_bytes(double bytes) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    int unit = 0;
+    while (bytes >= 1024.0 && unit < 4) {
+        bytes /= 1024.0;
+        unit++;
+    }
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << bytes << " " << units[unit];
+    return oss.str();
+}
+
+static bool stdout_is_terminal() {
+#ifdef _WIN32
+    return _isatty(_fileno(stdout)) != 0;
+#else
+    return isatty(STDOUT_FILENO) != 0;
+#endif
+}
+
+/**
+ * @brief 在终端同一行定期刷新已处理字节数和速率
+ *
+ * 短于半秒的操作不输出进度，避免小文件复制时闪烁。
+ */
+class ProgressReporter {
+public:
+    ProgressReporter(const char* verb, const std::atomic<uint64_t>& bytes)
+        : verb(verb), bytes(bytes), start(std::chrono::steady_clock::now()) {
+        if (stdout_is_terminal()) {
+            reporter = std::thread([this]() { run(); });
+        }
+    }
+
+    ~ProgressReporter() { stop(); }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (done) return;
+            done = true;
+        }
+        wake.notify_all();
+        if (reporter.joinable()) reporter.join();
+        if (printed) {
+            std::cout << "\r\033[K";
+            std::cout.flush();
+        }
+    }
+
+    double elapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!wake.wait_for(lock, std::chrono::milliseconds(250), [this]() { return done; })) {
+            double secs = elapsed();
+            if (secs < 0.5) continue;
+            uint64_t current = bytes.load(std::memory_order_relaxed);
+            std::cout << "\r" << verb << ": " << format_bytes(static_cast<double>(current))
+                      << ", " << format_bytes(current / secs) << "/s\033[K";
+            std::cout.flush();
+            printed = true;
+        }
+    }
+
+    const char* verb;
+    const std::atomic<uint64_t>& bytes;
+    std::chrono::steady_clock::time_point start;
+    std::thread reporter;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool done = false;
+    bool printed = false;
+};
+
+static void print_summary(const char* verb, const FileOpStats& stats, double secs, bool show_rate = true) {
+    // 全部失败时只显示错误信息
+    if (stats.files.load() == 0 && stats.dirs.load() == 0 && !stats.errors.empty()) return;
+
+    uint64_t bytes = stats.bytes.load();
+    std::ostringstream oss;
+    oss << verb << " " << stats.files.load() << " file(s)";
+    if (stats.dirs.load() > 0) oss << ", " << stats.dirs.load() << " dir(s)";
+    oss << ", " << format_bytes(static_cast<double>(bytes))
+        << " in " << std::fixed << std::setprecision(2) << secs << " s";
+    if (show_rate && secs > 0 && bytes > 0) oss << " (" << format_bytes(bytes / secs) << "/s)";
+    if (stats.reflinks.load() > 0) oss << ", " << stats.reflinks.load() << " reflinked";
+    println(GREEN << oss.str() << RESET);
+}
+
+static void print_errors(FileOpStats& stats) {
+    std::lock_guard<std::mutex> lock(stats.error_mutex);
+    for (const auto& error : stats.errors) {
+        println(RED << BOLD << error << RESET);
+    }
+}
+
+#ifndef _WIN32
+
+// ---------------- POSIX 数据复制 ----------------
+// 依次尝试 reflink、copy_file_range、sendfile，最后退回到缓冲读写。
+// 每一步返回 Fallback 表示当前文件系统或内核不支持，交给下一种方式继续。
+
+enum class CopyStep { Done, Fallback, Failed };
+
+static constexpr size_t COPY_CHUNK = 8 * 1024 * 1024;
+
+#ifdef __linux__
+static bool is_fallback_errno(int err) {
+    return err == ENOSYS || err == EXDEV || err == EINVAL || err == EBADF ||
+           err == EOPNOTSUPP || err == ENOTSUP || err == EPERM || err == ETXTBSY;
+}
+
+static CopyStep copy_by_reflink(int in_fd, int out_fd, uint64_t size, FileOpStats& stats) {
+#ifdef FICLONE
+    if (ioctl(out_fd, FICLONE, in_fd) == 0) {
+        stats.bytes += size;
+        stats.reflinks++;
+        return CopyStep::Done;
+    }
+#endif
+    return CopyStep::Fallback;
+}
+
+static CopyStep copy_by_copy_file_range(int in_fd, int out_fd, FileOpStats& stats) {
+    bool copied_any = false;
+    for (;;) {
+        ssize_t n = copy_file_range(in_fd, nullptr, out_fd, nullptr, COPY_CHUNK, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return is_fallback_errno(errno) ? CopyStep::Fallback : CopyStep::Failed;
+        }
+        if (n == 0) {
+            // procfs 等伪文件系统会直接返回 0，交给后续方式确认是否真的到达末尾
+            return copied_any ? CopyStep::Done : CopyStep::Fallback;
+        }
+        copied_any = true;
+        stats.bytes += static_cast<uint64_t>(n);
+    }
+}
+
+static CopyStep copy_by_sendfile(int in_fd, int out_fd, FileOpStats& stats) {
+    bool copied_any = false;
+    for (;;) {
+        ssize_t n = sendfile(out_fd, in_fd, nullptr, COPY_CHUNK);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return is_fallback_errno(errno) ? CopyStep::Fallback : CopyStep::Failed;
+        }
+        if (n == 0) {
+            return copied_any ? CopyStep::Done : CopyStep::Fallback;
+        }
+        copied_any = true;
+        stats.bytes += static_cast<uint64_t>(n);
+    }
+}
+#endif // __linux__
+
+static CopyStep copy_by_read_write(int in_fd, int out_fd, FileOpStats& stats) {
+    std::vector<char> buffer(256 * 1024);
+    for (;;) {
+        ssize_t n = ::read(in_fd, buffer.data(), buffer.size());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return CopyStep::Failed;
+        }
+        if (n == 0) return CopyStep::Done;
+
+        ssize_t written = 0;
+        while (written < n) {
+            ssize_t w = ::write(out_fd, buffer.data() + written, static_cast<size_t>(n - written));
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return CopyStep::Failed;
+            }
+            written += w;
+        }
+        stats.bytes += static_cast<uint64_t>(n);
+    }
+}
+
+static bool copy_file_contents(int in_fd, int out_fd, uint64_t size, FileOpStats& stats) {
+    CopyStep step = CopyStep::Fallback;
+#ifdef __linux__
+    if (size > 0) {
+        step = copy_by_reflink(in_fd, out_fd, size, stats);
+        if (step == CopyStep::Fallback) step = copy_by_copy_file_range(in_fd, out_fd, stats);
+        if (step == CopyStep::Fallback) step = copy_by_sendfile(in_fd, out_fd, stats);
+    }
+#else
+    (void)size;
+#endif
+    if (step == CopyStep::Fallback) step = copy_by_read_write(in_fd, out_fd, stats);
+    return step == CopyStep::Done;
+}
+
+static void apply_times(int fd, const struct stat& st) {
+    struct timespec times[2] = {STAT_ATIME(st), STAT_MTIME(st)};
+    futimens(fd, times);
+}
+
+static void copy_regular_file(const std::string& src, const std::string& dst, const struct stat& st,
+                              const FileOpOptions& opts, FileOpStats& stats) {
+    int in_fd = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in_fd < 0) {
+        stats.add_error("Cannot open " + src + ": " + strerror(errno));
+        return;
+    }
+
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (opts.no_clobber ? O_EXCL : O_TRUNC);
+    int out_fd = open(dst.c_str(), flags, st.st_mode & 07777);
+    if (out_fd < 0) {
+        int err = errno;
+        if (opts.no_clobber && err == EEXIST) stats.skipped++;
+        else stats.add_error("Cannot create " + dst + ": " + strerror(err));
+        close(in_fd);
+        return;
+    }
+
+#ifdef __linux__
+    posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    bool ok = copy_file_contents(in_fd, out_fd, static_cast<uint64_t>(st.st_size), stats);
+    if (!ok) {
+        stats.add_error("Failed to copy " + src + " -> " + dst + ": " + strerror(errno));
+    }
+    else if (opts.preserve) {
+        fchmod(out_fd, st.st_mode & 07777);
+        apply_times(out_fd, st);
+    }
+
+    close(in_fd);
+    if (close(out_fd) != 0 && ok) {
+        stats.add_error("Failed to write " + dst + ": " + strerror(errno));
+        ok = false;
+    }
+    if (ok) stats.files++;
+}
+
+static void copy_symlink(const std::string& src, const std::string& dst, FileOpStats& stats) {
+    std::vector<char> target(PATH_MAX);
+    ssize_t len = readlink(src.c_str(), target.data(), target.size() - 1);
+    if (len < 0) {
+        stats.add_error("Cannot read link " + src + ": " + strerror(errno));
+        return;
+    }
+    target[len] = '\0';
+    if (symlink(target.data(), dst.c_str()) != 0) {
+        stats.add_error("Cannot create link " + dst + ": " + strerror(errno));
+        return;
+    }
+    stats.files++;
+}
+
+// 目录权限需在内容复制完成后再设置，否则只读目录无法写入
+struct DirFixup {
+    std::string path;
+    struct stat st;
+};
+
+static void copy_tree(const std::string& src, const std::string& dst, const struct stat& src_st,
+                      const FileOpOptions& opts, FileOpStats& stats, WorkerPool& pool,
+                      std::vector<DirFixup>& fixups) {
+    if (mkdir(dst.c_str(), 0700) != 0 && !(errno == EEXIST && is_directory_exists(dst))) {
+        stats.add_error("Cannot create directory " + dst + ": " + strerror(errno));
+        return;
+    }
+    fixups.push_back({dst, src_st});
+
+    DIR* dir = opendir(src.c_str());
+    if (!dir) {
+        stats.add_error("Cannot open directory " + src + ": " + strerror(errno));
+        return;
+    }
+    stats.dirs++;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        const char* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+        struct stat st{};
+        if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            stats.add_error("Cannot stat " + path_join(src, name) + ": " + strerror(errno));
+            continue;
+        }
+
+        std::string child_src = path_join(src, name);
+        std::string child_dst = path_join(dst, name);
+        if (S_ISDIR(st.st_mode)) {
+            copy_tree(child_src, child_dst, st, opts, stats, pool, fixups);
+        }
+        else if (S_ISREG(st.st_mode)) {
+            // 小文件的打开/关闭开销远大于数据复制本身，交给线程池并行处理
+            pool.submit([child_src, child_dst, st, &opts, &stats]() {
+                copy_regular_file(child_src, child_dst, st, opts, stats);
+            });
+        }
+        else if (S_ISLNK(st.st_mode)) {
+            copy_symlink(child_src, child_dst, stats);
+        }
+        else {
+            stats.add_error("Skipping special file " + child_src);
+        }
+    }
+    closedir(dir);
+}
+
+static void apply_dir_fixups(std::vector<DirFixup>& fixups, const FileOpOptions& opts) {
+    // 由深到浅设置，避免修改父目录时间戳后又被子目录写入覆盖
+    for (auto it = fixups.rbegin(); it != fixups.rend(); ++it) {
+        chmod(it->path.c_str(), it->st.st_mode & 07777);
+        if (opts.preserve) {
+            struct timespec times[2] = {STAT_ATIME(it->st), STAT_MTIME(it->st)};
+            utimensat(AT_FDCWD, it->path.c_str(), times, 0);
+        }
+    }
+    fixups.clear();
+}
+
+static bool copy_path(const std::string& src, const std::string& dst, const FileOpOptions& opts,
+                      FileOpStats& stats) {
+    struct stat st{};
+    if (stat(src.c_str(), &st) != 0) {
+        stats.add_error("Cannot stat " + src + ": " + strerror(errno));
+        return false;
+    }
+
+    struct stat dst_st{};
+    if (stat(dst.c_str(), &dst_st) == 0 && dst_st.st_dev == st.st_dev && dst_st.st_ino == st.st_ino) {
+        stats.add_error("'" + src + "' and '" + dst + "' are the same file");
+        return false;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        if (!opts.recursive) {
+            stats.add_error("Omitting directory " + src + " (use -r)");
+            return false;
+        }
+        if (dst.compare(0, src.length() + 1, src + "/") == 0) {
+            stats.add_error("Cannot copy directory " + src + " into itself");
+            return false;
+        }
+        WorkerPool pool;
+        std::vector<DirFixup> fixups;
+        copy_tree(src, dst, st, opts, stats, pool, fixups);
+        pool.wait_idle();
+        apply_dir_fixups(fixups, opts);
+    }
+    else {
+        copy_regular_file(src, dst, st, opts, stats);
+    }
+    return true;
+}
+
+// 自底向上删除目录树，全部操作都相对于目录 fd，避免重复解析路径前缀
+static void remove_tree_at(int parent_fd, const char* name, const std::string& display_path,
+                           FileOpStats& stats) {
+    struct stat st{};
+    if (fstatat(parent_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        stats.add_error("Cannot stat " + display_path + ": " + strerror(errno));
+        return;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        if (unlinkat(parent_fd, name, 0) != 0) {
+            stats.add_error("Failed to delete " + display_path + ": " + strerror(errno));
+            return;
+        }
+        stats.files++;
+        stats.bytes += static_cast<uint64_t>(st.st_size);
+        return;
+    }
+
+    int fd = openat(parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    DIR* dir = fd >= 0 ? fdopendir(fd) : nullptr;
+    if (!dir) {
+        if (fd >= 0) close(fd);
+        stats.add_error("Cannot open directory " + display_path + ": " + strerror(errno));
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        remove_tree_at(dirfd(dir), entry->d_name, path_join(display_path, entry->d_name), stats);
+    }
+    closedir(dir);
+
+    if (unlinkat(parent_fd, name, AT_REMOVEDIR) != 0) {
+        stats.add_error("Failed to remove directory " + display_path + ": " + strerror(errno));
+        return;
+    }
+    stats.dirs++;
+}
+
+static void remove_path(const std::string& path, FileOpStats& stats) {
+    std::string parent = path_dirname(path);
+    std::string name = path_basename(path);
+
+    int parent_fd = open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (parent_fd < 0) {
+        stats.add_error("Cannot open directory " + parent + ": " + strerror(errno));
+        return;
+    }
+    remove_tree_at(parent_fd, name.c_str(), path, stats);
+    close(parent_fd);
+}
+
+// 顶层目录需等所有子树删除完成后才能删除
+struct PendingDir {
+    int parent_fd;
+    int dir_fd;
+    std::string name;
+    std::string display_path;
+};
+
+/**
+ * @brief 开始删除一个 rm 参数
+ *
+ * 文件直接删除；目录的每个子目录作为独立子树提交给线程池，
+ * 目录本身加入 pending，待线程池空闲后由 finish_pending_dirs() 删除。
+ */
+static void begin_remove(const std::string& path, const FileOpOptions& opts, FileOpStats& stats,
+                         WorkerPool& pool, std::vector<PendingDir>& pending) {
+    std::string parent = path_dirname(path);
+    std::string name = path_basename(path);
+
+    int parent_fd = open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    struct stat st{};
+    if (parent_fd < 0 || fstatat(parent_fd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        if (!(opts.force && errno == ENOENT)) {
+            stats.add_error("Cannot remove " + path + ": " + strerror(errno));
+        }
+        if (parent_fd >= 0) close(parent_fd);
+        return;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        remove_tree_at(parent_fd, name.c_str(), path, stats);
+        close(parent_fd);
+        return;
+    }
+    if (!opts.recursive) {
+        stats.add_error("Cannot remove " + path + ": Is a directory (use -r)");
+        close(parent_fd);
+        return;
+    }
+
+    int dir_fd = openat(parent_fd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    int list_fd = dir_fd >= 0 ? dup(dir_fd) : -1;
+    DIR* dir = list_fd >= 0 ? fdopendir(list_fd) : nullptr;
+    if (!dir) {
+        stats.add_error("Cannot open directory " + path + ": " + strerror(errno));
+        if (list_fd >= 0) close(list_fd);
+        if (dir_fd >= 0) close(dir_fd);
+        close(parent_fd);
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        const char* child = entry->d_name;
+        if (strcmp(child, ".") == 0 || strcmp(child, "..") == 0) continue;
+
+        bool is_dir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat child_st{};
+            is_dir = fstatat(dir_fd, child, &child_st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(child_st.st_mode);
+        }
+
+        std::string child_path = path_join(path, child);
+        if (is_dir) {
+            std::string child_name(child);
+            pool.submit([dir_fd, child_name, child_path, &stats]() {
+                remove_tree_at(dir_fd, child_name.c_str(), child_path, stats);
+            });
+        }
+        else {
+            remove_tree_at(dir_fd, child, child_path, stats);
+        }
+    }
+    closedir(dir);
+
+    pending.push_back({parent_fd, dir_fd, name, path});
+}
+
+static void finish_pending_dirs(std::vector<PendingDir>& pending, FileOpStats& stats) {
+    for (auto& dir : pending) {
+        close(dir.dir_fd);
+        if (unlinkat(dir.parent_fd, dir.name.c_str(), AT_REMOVEDIR) != 0) {
+            stats.add_error("Failed to remove directory " + dir.display_path + ": " + strerror(errno));
+        }
+        else {
+            stats.dirs++;
+        }
+        close(dir.parent_fd);
+    }
+    pending.clear();
+}
+
+/**
+ * @brief 批量创建时缓存已打开的目录 fd
+ *
+ * 同一次调用中共享前缀的路径只解析一次，之后全部通过 mkdirat/openat 相对操作。
+ */
+class DirFdCache {
+public:
+    DirFdCache() = default;
+    DirFdCache(const DirFdCache&) = delete;
+    DirFdCache& operator=(const DirFdCache&) = delete;
+
+    ~DirFdCache() {
+        for (auto& entry : fds) close(entry.second);
+    }
+
+    // 打开目录；create_missing 时逐级创建不存在的父目录（类似 mkdir -p）
+    int open_dir(const std::string& path, bool create_missing, FileOpStats& stats) {
+        auto it = fds.find(path);
+        if (it != fds.end()) return it->second;
+
+        int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0 && errno == ENOENT && create_missing) {
+            std::string parent = path_dirname(path);
+            if (parent == path) return -1;
+
+            int parent_fd = open_dir(parent, true, stats);
+            if (parent_fd < 0) return -1;
+
+            std::string name = path_basename(path);
+            if (mkdirat(parent_fd, name.c_str(), 0755) == 0) {
+                stats.dirs++;
+            }
+            else if (errno != EEXIST) {
+                return -1;
+            }
+            fd = openat(parent_fd, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+        if (fd >= 0) fds[path] = fd;
+        return fd;
+    }
+
+private:
+    std::unordered_map<std::string, int> fds;
+};
+
+// 为新文件预分配空间；不支持 fallocate 的文件系统退回到 ftruncate（稀疏文件）
+static bool preallocate(int fd, uint64_t size) {
+#ifdef __linux__
+    if (fallocate(fd, 0, 0, static_cast<off_t>(size)) == 0) return true;
+    if (errno != EOPNOTSUPP && errno != ENOSYS) return false;
+#endif
+    return ftruncate(fd, static_cast<off_t>(size)) == 0;
+}
+
+static void create_entry(const std::string& path, const FileOpOptions& opts, DirFdCache& cache,
+                         FileOpStats& stats) {
+    std::string name = path_basename(path);
+    int parent_fd = cache.open_dir(path_dirname(path), opts.parents, stats);
+    if (parent_fd < 0) {
+        stats.add_error("Cannot create " + path + ": " + strerror(errno));
+        return;
+    }
+
+    if (opts.directory) {
+        if (mkdirat(parent_fd, name.c_str(), 0755) == 0) {
+            stats.dirs++;
+        }
+        else if (!(errno == EEXIST && opts.parents)) {
+            stats.add_error("Cannot create directory " + path + ": " + strerror(errno));
+        }
+        return;
+    }
+
+    int fd = openat(parent_fd, name.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        stats.add_error("Cannot create file " + path + ": " + strerror(errno));
+        return;
+    }
+    if (opts.size > 0 && !preallocate(fd, opts.size)) {
+        stats.add_error("Cannot allocate " + format_bytes(static_cast<double>(opts.size)) +
+                        " for " + path + ": " + strerror(errno));
+        close(fd);
+        return;
+    }
+    close(fd);
+    stats.files++;
+    stats.bytes += opts.size;
+}
+
+static bool move_path(const std::string& src, const std::string& dst, const FileOpOptions& opts,
+                      FileOpStats& stats) {
+    int result;
+    int err = 0;
+#if defined(__linux__) && defined(RENAME_NOREPLACE)
+    result = renameat2(AT_FDCWD, src.c_str(), AT_FDCWD, dst.c_str(), opts.no_clobber ? RENAME_NOREPLACE : 0);
+    if (result != 0) err = errno;
+    if (result != 0 && err == EINVAL && opts.no_clobber) {
+        // 部分文件系统不支持 RENAME_NOREPLACE，退回到先检查再 rename
+        struct stat st{};
+        if (lstat(dst.c_str(), &st) == 0) return true;
+        result = rename(src.c_str(), dst.c_str());
+        if (result != 0) err = errno;
+    }
+#else
+    struct stat existing{};
+    if (opts.no_clobber && lstat(dst.c_str(), &existing) == 0) return true;
+    result = rename(src.c_str(), dst.c_str());
+    if (result != 0) err = errno;
+#endif
+    if (result == 0) {
+        stats.files++;
+        return true;
+    }
+    if (err == EEXIST && opts.no_clobber) return true;
+    if (err != EXDEV) {
+        stats.add_error("Failed to move " + src + " -> " + dst + ": " + strerror(err));
+        return false;
+    }
+
+    // EXDEV 在检查目标之前就会返回，-n 时目标已存在则什么也不做
+    struct stat dst_st{};
+    if (opts.no_clobber && lstat(dst.c_str(), &dst_st) == 0) return true;
+
+    // 跨文件系统：先完整复制（保留权限和时间），成功后再删除源
+    FileOpOptions copy_opts = opts;
+    copy_opts.recursive = true;
+    copy_opts.preserve = true;
+
+    FileOpStats copy_stats;
+    copy_path(src, dst, copy_opts, copy_stats);
+    stats.bytes += copy_stats.bytes.load();
+    if (!copy_stats.errors.empty()) {
+        for (const auto& error : copy_stats.errors) stats.add_error(error);
+        stats.add_error("Source kept because copying " + src + " failed");
+        return false;
+    }
+    // 复制期间目标中出现了同名文件而被跳过，源中仍有未移动的内容，不能删除
+    if (copy_stats.skipped > 0) {
+        stats.add_error("Source kept because " + std::to_string(copy_stats.skipped.load()) +
+                        " file(s) already exist under " + dst);
+        return false;
+    }
+
+    FileOpStats remove_stats;
+    remove_path(src, remove_stats);
+    for (const auto& error : remove_stats.errors) stats.add_error(error);
+    stats.files++;
+    return remove_stats.errors.empty();
+}
+
+#else // _WIN32
+
+// ---------------- Windows 实现 ----------------
+
+static uint64_t win_file_size(const WIN32_FILE_ATTRIBUTE_DATA& data) {
+    return (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+}
+
+static void copy_regular_file(const std::string& src, const std::string& dst, uint64_t size,
+                              const FileOpOptions& opts, FileOpStats& stats) {
+    if (!CopyFileA(src.c_str(), dst.c_str(), opts.no_clobber ? TRUE : FALSE)) {
+        DWORD err = GetLastError();
+        if (!(opts.no_clobber && err == ERROR_FILE_EXISTS)) {
+            stats.add_error("Failed to copy " + src + " -> " + dst + ". Error: " + std::to_string(err));
+        }
+        return;
+    }
+    stats.files++;
+    stats.bytes += size;
+}
+
+static void copy_tree(const std::string& src, const std::string& dst, const FileOpOptions& opts,
+                      FileOpStats& stats, WorkerPool& pool) {
+    if (!CreateDirectoryA(dst.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
+        stats.add_error("Cannot create directory " + dst + ". Error: " + std::to_string(GetLastError()));
+        return;
+    }
+    stats.dirs++;
+
+    WIN32_FIND_DATAA findData;
+    HANDLE hFind = FindFirstFileA((src + "\\*").c_str(), &findData);
+    if (hFind == INVALID_HANDLE_VALUE) return;
+
+    do {
+        std::string name(findData.cFileName);
+        if (name == "." || name == "..") continue;
+
+        std::string child_src = path_join(src, name);
+        std::string child_dst = path_join(dst, name);
+        if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            copy_tree(child_src, child_dst, opts, stats, pool);
+        }
+        else {
+            uint64_t size = (static_cast<uint64_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+            pool.submit([child_src, child_dst, size, &opts, &stats]() {
+                copy_regular_file(child_src, child_dst, size, opts, stats);
+            });
+        }
+    }
+    while (FindNextFileA(hFind, &findData));
+    FindClose(hFind);
+}
+
+static bool copy_path(const std::string& src, const std::string& dst, const FileOpOptions& opts,
+                      FileOpStats& stats) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(src.c_str(), GetFileExInfoStandard, &data)) {
+        stats.add_error("Cannot access " + src);
+        return false;
+    }
+
+    if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        if (!opts.recursive) {
+            stats.add_error("Omitting directory " + src + " (use -r)");
+            return false;
+        }
+        WorkerPool pool;
+        copy_tree(src, dst, opts, stats, pool);
+        pool.wait_idle();
+    }
+    else {
+        copy_regular_file(src, dst, win_file_size(data), opts, stats);
+    }
+    return true;
+}
+
+static bool move_path(const std::string& src, const std::string& dst, const FileOpOptions& opts,
+                      FileOpStats& stats) {
+    DWORD flags = MOVEFILE_COPY_ALLOWED | (opts.no_clobber ? 0 : MOVEFILE_REPLACE_EXISTING);
+    if (!MoveFileExA(src.c_str(), dst.c_str(), flags)) {
+        DWORD err = GetLastError();
+        if (opts.no_clobber && (err == ERROR_ALREADY_EXISTS || err == ERROR_FILE_EXISTS)) return true;
+        stats.add_error("Failed to move " + src + " -> " + dst + ". Error: " + std::to_string(err));
+        return false;
+    }
+    stats.files++;
+    return true;
+}
+
+static void remove_tree(const std::string& path, FileOpStats& stats) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data)) {
+        stats.add_error("Cannot access " + path);
+        return;
+    }
+
+    bool is_dir = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+                  !(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT);
+    if (!is_dir) {
+        if (!DeleteFileA(path.c_str())) {
+            stats.add_error("Failed to delete " + path + ". Error: " + std::to_string(GetLastError()));
+            return;
+        }
+        stats.files++;
+        stats.bytes += win_file_size(data);
+        return;
+    }
+
+    WIN32_FIND_DATAA findData;
+    HANDLE hFind = FindFirstFileA((path + "\\*").c_str(), &findData);
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            std::string name(findData.cFileName);
+            if (name != "." && name != "..") remove_tree(path_join(path, name), stats);
+        }
+        while (FindNextFileA(hFind, &findData));
+        FindClose(hFind);
+    }
+
+    if (!RemoveDirectoryA(path.c_str())) {
+        stats.add_error("Failed to remove directory " + path + ". Error: " + std::to_string(GetLastError()));
+        return;
+    }
+    stats.dirs++;
+}
+
+static bool create_parents(const std::string& dir, FileOpStats& stats) {
+    if (dir.empty() || is_directory_exists(dir)) return true;
+    std::string parent = path_dirname(dir);
+    if (parent != dir && !create_parents(parent, stats)) return false;
+    if (CreateDirectoryA(dir.c_str(), nullptr)) {
+        stats.dirs++;
+        return true;
+    }
+    return GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+static void create_entry(const std::string& path, const FileOpOptions& opts, FileOpStats& stats) {
+    if (opts.parents && !create_parents(path_dirname(path), stats)) {
+        stats.add_error("Cannot create parent directories of " + path + ". Error: " + std::to_string(GetLastError()));
+        return;
+    }
+
+    if (opts.directory) {
+        if (CreateDirectoryA(path.c_str(), nullptr)) {
+            stats.dirs++;
+        }
+        else if (!(GetLastError() == ERROR_ALREADY_EXISTS && opts.parents)) {
+            stats.add_error("Cannot create directory " + path + ". Error: " + std::to_string(GetLastError()));
+        }
+        return;
+    }
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        stats.add_error("Cannot create file " + path + ". Error: " + std::to_string(GetLastError()));
+        return;
+    }
+    if (opts.size > 0) {
+        LARGE_INTEGER size;
+        size.QuadPart = static_cast<LONGLONG>(opts.size);
+        if (!SetFilePointerEx(file, size, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+            stats.add_error("Cannot allocate space for " + path + ". Error: " + std::to_string(GetLastError()));
+            CloseHandle(file);
+            return;
+        }
+    }
+    CloseHandle(file);
+    stats.files++;
+    stats.bytes += opts.size;
+}
+
+#endif // _WIN32
+
+// 解析 10K、4M、1G 形式的大小
+static bool parse_size(const std::string& text, uint64_t& size) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) return false;
+    size_t consumed = 0;
+    unsigned long long value;
+    try {
+        value = std::stoull(text, &consumed);
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    std::string suffix = text.substr(consumed);
+    uint64_t multiplier = 1;
+    if (suffix.empty() || suffix == "B") multiplier = 1;
+    else if (suffix == "K" || suffix == "KiB") multiplier = 1ULL << 10;
+    else if (suffix == "M" || suffix == "MiB") multiplier = 1ULL << 20;
+    else if (suffix == "G" || suffix == "GiB") multiplier = 1ULL << 30;
+    else return false;
+
+    // 乘以单位后超出 64 位时同样视为无效大小
+    if (value > UINT64_MAX / multiplier) return false;
+    size = static_cast<uint64_t>(value) * multiplier;
+    return true;
+}
+
+// 展开参数中的通配符；没有匹配时保留原样，由后续操作报告不存在
+static std::vector<std::string> expand_globs(const std::vector<std::string>& paths) {
+    std::vector<std::string> expanded;
+    for (const auto& path : paths) {
+        if (path.find_first_of("*?[") == std::string::npos) {
+            expanded.push_back(path);
+            continue;
+        }
+#ifdef _WIN32
+        // FindFirstFileA 只支持最后一段路径中的通配符
+        size_t sep = path.find_last_of("/\\");
+        std::string dir = sep == std::string::npos ? dir_now : path.substr(0, sep);
+        WIN32_FIND_DATAA findData;
+        HANDLE hFind = FindFirstFileA(path.c_str(), &findData);
+        if (hFind == INVALID_HANDLE_VALUE) {
+            expanded.push_back(path);
+            continue;
+        }
+        do {
+            std::string name(findData.cFileName);
+            if (name != "." && name != "..") expanded.push_back(path_join(dir, name));
+        }
+        while (FindNextFileA(hFind, &findData));
+        FindClose(hFind);
+#else
+        glob_t matches{};
+        if (glob(path.c_str(), 0, nullptr, &matches) == 0) {
+            for (size_t i = 0; i < matches.gl_pathc; ++i) {
+                expanded.emplace_back(matches.gl_pathv[i]);
+            }
+        }
+        else {
+            expanded.push_back(path);
+        }
+        globfree(&matches);
+#endif
+    }
+    return expanded;
+}
+
+// 解析 -rnp 形式的组合选项，返回非选项参数（已解析为绝对路径）
+static bool parse_fileop_args(const std::vector<std::string>& cmd, const std::string& allowed,
+                            FileOpOptions& opts, std::vector<std::string>& paths) {
+    bool options_done = false;
+    for (size_t i = 1; i < cmd.size(); ++i) {
+        const std::string& arg = cmd[i];
+        if (!options_done && arg == "--") {
+            options_done = true;
+            continue;
+        }
+        if (!options_done && arg.length() > 1 && arg[0] == '-') {
+            for (size_t j = 1; j < arg.length(); ++j) {
+                char flag = arg[j];
+                if (allowed.find(flag) == std::string::npos) {
+                    println(RED << BOLD << "Unknown option: -" << flag << RESET);
+                    return false;
+                }
+                if (flag == 'r' || flag == 'R') opts.recursive = true;
+                else if (flag == 'n') opts.no_clobber = true;
+                else if (flag == 'p') opts.preserve = true;
+                else if (flag == 'f') opts.force = true;
+            }
+            continue;
+        }
+        paths.push_back(resolve_path(arg));
+    }
+    return true;
+}
+
+// 目标为已存在目录时放入其中，否则直接作为目标路径
+static bool build_targets(const std::vector<std::string>& paths,
+                          std::vector<std::pair<std::string, std::string>>& targets) {
+    std::vector<std::string> sources(paths.begin(), paths.end() - 1);
+    const std::string& dest = paths.back();
+
+    if (is_directory_exists(dest)) {
+        for (const auto& src : sources) {
+            targets.emplace_back(src, path_join(dest, path_basename(src)));
+        }
+        return true;
+    }
+    if (sources.size() > 1) {
+        println(RED << BOLD << "Target is not a directory: " << dest << RESET);
+        return false;
+    }
+    targets.emplace_back(sources.front(), dest);
+    return true;
+}
+
+int builtin_copy(const std::vector<std::string>& cmd) {
+    FileOpOptions opts;
+    std::vector<std::string> paths;
+    if (!parse_fileop_args(cmd, "rRnp", opts, paths) || paths.size() < 2) {
+        println("Usage: { cp | copy | CopyItem } [options] <source>... <destination>\n"
+                "Options:\n"
+                "    -r      Copy directories recursively.\n"
+                "    -n      Do not overwrite existing files.\n"
+                "    -p      Preserve mode and timestamps.");
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, std::string>> targets;
+    if (!build_targets(paths, targets)) return 1;
+
+    FileOpStats stats;
+    ProgressReporter progress("Copying", stats.bytes);
+    for (const auto& target : targets) {
+        copy_path(target.first, target.second, opts, stats);
+    }
+    progress.stop();
+
+    DirCache::sync();
+    print_errors(stats);
+    print_summary("Copied", stats, progress.elapsed());
+    return stats.errors.empty() ? 0 : 1;
+}
+
+int builtin_move(const std::vector<std::string>& cmd) {
+    FileOpOptions opts;
+    std::vector<std::string> paths;
+    if (!parse_fileop_args(cmd, "n", opts, paths) || paths.size() < 2) {
+        println("Usage: { mv | move | MoveItem } [options] <source>... <destination>\n"
+                "Options:\n"
+                "    -n      Do not overwrite existing files.");
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, std::string>> targets;
+    if (!build_targets(paths, targets)) return 1;
+
+    FileOpStats stats;
+    ProgressReporter progress("Moving", stats.bytes);
+    for (const auto& target : targets) {
+        move_path(target.first, target.second, opts, stats);
+    }
+    progress.stop();
+
+    DirCache::sync();
+    print_errors(stats);
+    print_summary("Moved", stats, progress.elapsed());
+    return stats.errors.empty() ? 0 : 1;
+}
+
+/**
+ * @brief 检查 rm 参数是否可以删除
+ *
+ * 最后一段为 . 或 .. 的参数会删到当前目录或其父目录，规范化后为根目录的参数会删掉整个文件系统，
+ * 与 GNU rm 一样一律拒绝（不受 -f 影响）。
+ */
+static bool check_remove_operand(const std::string& path, FileOpStats& stats) {
+    std::string name = path_basename(path);
+    if (name == "." || name == "..") {
+        stats.add_error("Refusing to remove '.' or '..' directory: " + path);
+        return false;
+    }
+    std::string normalized = normalize_path(resolve_path(path));
+    if (!normalized.empty() && normalized.size() <= 3 &&
+        (normalized.back() == '/' || normalized.back() == '\\')) {
+        stats.add_error("Refusing to remove root directory: " + path);
+        return false;
+    }
+    return true;
+}
+
+int builtin_remove(const std::vector<std::string>& cmd) {
+    FileOpOptions opts;
+    std::vector<std::string> paths;
+    if (!parse_fileop_args(cmd, "rRf", opts, paths) || paths.empty()) {
+        println("Usage: { rm | rmv | RemoveItem | del } [options] <path>...\n"
+                "Options:\n"
+                "    -r      Remove directories and their contents recursively.\n"
+                "    -f      Ignore nonexistent files.");
+        return 1;
+    }
+    paths = expand_globs(paths);
+
+    FileOpStats stats;
+    auto start = std::chrono::steady_clock::now();
+#ifdef _WIN32
+    for (const auto& path : paths) {
+        if (!check_remove_operand(path, stats)) continue;
+        DWORD attrs = GetFileAttributesA(path.c_str());
+        if (attrs == INVALID_FILE_ATTRIBUTES) {
+            if (!opts.force) stats.add_error("Cannot remove " + path + ": No such file or directory");
+            continue;
+        }
+        if ((attrs & FILE_ATTRIBUTE_DIRECTORY) && !opts.recursive) {
+            stats.add_error("Cannot remove " + path + ": Is a directory (use -r)");
+            continue;
+        }
+        remove_tree(path, stats);
+    }
+#else
+    WorkerPool pool;
+    std::vector<PendingDir> pending;
+    for (const auto& path : paths) {
+        if (!check_remove_operand(path, stats)) continue;
+        begin_remove(path, opts, stats, pool, pending);
+    }
+    pool.wait_idle();
+    finish_pending_dirs(pending, stats);
+#endif
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    DirCache::sync();
+    print_errors(stats);
+    print_summary("Removed", stats, secs, false);
+    return stats.errors.empty() ? 0 : 1;
+}
+
+int builtin_create(const std::vector<std::string>& cmd) {
+    FileOpOptions opts;
+    std::vector<std::string> paths;
+    bool valid = true;
+
+    for (size_t i = 1; i < cmd.size() && valid; ++i) {
+        const std::string& arg = cmd[i];
+        if (arg == "--size" || arg.compare(0, 7, "--size=") == 0) {
+            std::string value = arg == "--size" ? (i + 1 < cmd.size() ? cmd[++i] : "") : arg.substr(7);
+            if (!parse_size(value, opts.size)) {
+                println(RED << BOLD << "Invalid size: " << value << RESET);
+                return 1;
+            }
+        }
+        else if (arg.length() > 1 && arg[0] == '-') {
+            for (size_t j = 1; j < arg.length(); ++j) {
+                if (arg[j] == 'f') opts.directory = false;
+                else if (arg[j] == 'd') opts.directory = true;
+                else if (arg[j] == 'p') opts.parents = true;
+                else {
+                    println(RED << BOLD << "Unknown option: -" << arg[j] << RESET);
+                    valid = false;
+                    break;
+                }
+            }
+        }
+        else {
+            paths.push_back(resolve_path(arg));
+        }
+    }
+
+    if (!valid || paths.empty()) {
+        println("Usage: { new | crt | mk } [options] <name>...\n"
+                "Options:\n"
+                "    -f          Create a file (default).\n"
+                "    -d          Create a directory.\n"
+                "    -p          Create missing parent directories.\n"
+                "    --size N    Preallocate N bytes for new files (K/M/G suffixes).");
+        return 1;
+    }
+    if (opts.directory && opts.size > 0) {
+        println(RED << BOLD << "--size only applies to files." << RESET);
+        return 1;
+    }
+
+    FileOpStats stats;
+    auto start = std::chrono::steady_clock::now();
+#ifdef _WIN32
+    for (const auto& path : paths) {
+        create_entry(path, opts, stats);
+    }
+#else
+    DirFdCache cache;
+    for (const auto& path : paths) {
+        create_entry(path, opts, cache, stats);
+    }
+#endif
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    DirCache::sync();
+    print_errors(stats);
+    print_summary("Created", stats, secs, false);
+    return stats.errors.empty() ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+#ifndef SHELL_FILEOPS_H
+#define SHELL_FILEOPS_H
+
+#include <string>
+#include <vector>
+
+// 内置文件操作命令，cmd 为完整的命令切分结果（cmd[0] 为命令名）
+int builtin_copy(const std::vector<std::string>& cmd);
+int builtin_move(const std::vector<std::string>& cmd);
+int builtin_remove(const std::vector<std::string>& cmd);
+int builtin_create(const std::vector<std::string>& cmd);
+
+#endif // SHELL_FILEOPS_H
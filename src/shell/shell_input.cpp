@@ -2,6 +2,7 @@
 #include <iomanip>
 #include <cctype>
 #include <deque>
+#include <iterator>
 #include <vector>
 #include <sstream>
 #ifdef _WIN32
@@ -15,23 +16,514 @@
 #include <regex>
 
 #include "../header.h"
+#include "history_log.h"
+#include "input_decoder.h"
+#include "line_render.h"
+#include "prompt_pipeline.h"
+#include "shell_completion.h"
 #include "shell_input.h"
+#include "shell_listing.h"
+#include "shell_path.h"
+#include "syntax_highlight.h"
+#include "terminal_session.h"
+#include "unicode_width.h"
 
 #ifndef _WIN32
-#include <dirent.h>
-#include <sys/stat.h>
-#include <termios.h>
+#include <cerrno>
+#include <poll.h>
 #include <unistd.h>
 #endif
 
-// 声明全局变量用于命令历史记录
-std::deque<std::string> command_history;
-size_t history_index = 0;
+// 在提示符下方按列列出补全候选（只显示最后一段名称）
+static void print_candidates(const std::vector<std::string>& candidates) {
+    const size_t max_shown = 200;
+    std::vector<std::string> names;
+    size_t widest = 0;
+    for (size_t i = 0; i < candidates.size() && i < max_shown; ++i) {
+        const std::string& candidate = candidates[i];
+        bool is_dir = !candidate.empty() && (candidate.back() == '/' || candidate.back() == '\\');
+        std::string name = path_basename(candidate) + (is_dir ? std::string(1, candidate.back()) : "");
+        widest = std::max(widest, text_width(name));
+        names.push_back(std::move(name));
+    }
+
+    const size_t gap = 2;
+    size_t cols = std::max<size_t>(1, (terminal_width() + gap) / (widest + gap));
+    size_t rows = (names.size() + cols - 1) / cols;
+    std::string out;
+    for (size_t row = 0; row < rows; ++row) {
+        for (size_t col = 0; col < cols; ++col) {
+            size_t i = col * rows + row;
+            if (i >= names.size()) break;
+            out += names[i];
+            if ((col + 1) * rows + row < names.size()) out.append(widest - text_width(names[i]) + gap, ' ');
+        }
+        out += '\n';
+    }
+    if (candidates.size() > max_shown) {
+        out += "... and " + std::to_string(candidates.size() - max_shown) + " more\n";
+    }
+    std::cout << out;
+}
+
+// Tab 补全：唯一候选直接补全，多个候选先补到公共前缀，无法继续时连按两次 Tab 列出候选
+static void handle_tab(std::string& buffer, size_t& cursor_pos, LineRenderer& renderer, bool repeated) {
+    Completion completion = complete_word(buffer, cursor_pos);
+    if (completion.candidates.empty()) {
+        renderer.bell();
+        return;
+    }
+
+    std::string replacement = completion.candidates.size() == 1 ? completion.candidates.front()
+                                                                 : longest_common_prefix(completion.candidates);
+    bool unique_file = completion.candidates.size() == 1 && !replacement.empty() &&
+                       replacement.back() != '/' && replacement.back() != '\\';
+    if (unique_file && (cursor_pos == buffer.size() || buffer[cursor_pos] != ' ')) replacement += ' ';
+
+    if (replacement.size() > completion.word.size()) {
+        buffer.replace(completion.word_start, completion.word.size(), replacement);
+        cursor_pos = completion.word_start + replacement.size();
+    }
+    else if (repeated) {
+        // 候选列在全部输入内容的下方，之后在列表下方重新显示提示符和输入内容
+        renderer.finish();
+        print_candidates(completion.candidates);
+        renderer.invalidate();
+    }
+    else {
+        renderer.bell();
+    }
+}
+
+// 粘贴内容作为单行命令插入：换行与制表符变为空格，去掉其他控制字符
+static std::string sanitize_paste(const std::string& text) {
+    std::string result;
+    result.reserve(text.size());
+    size_t end = text.find_last_not_of("\r\n");
+    for (size_t i = 0; end != std::string::npos && i <= end; ++i) {
+        auto c = static_cast<unsigned char>(text[i]);
+        if (c == '\r' || c == '\n' || c == '\t') result += ' ';
+        else if (c >= 32 && c != 127) result += static_cast<char>(c);
+    }
+    return result;
+}
+
+// 反斜杠加换行表示续行，执行前去掉；其余换行（在未闭合的 ${ 中）原样保留在命令中
+static std::string join_continued_lines(const std::string& text) {
+    std::string result;
+    result.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\\' && i + 1 < text.size() && text[i + 1] == '\n') {
+            i++;
+            continue;
+        }
+        result += text[i];
+    }
+    return result;
+}
+
+static bool is_word_char(char c) {
+    auto byte = static_cast<unsigned char>(c);
+    return std::isalnum(byte) || byte >= 0x80 || c == '_';
+}
+
+// 上一次历史搜索的查询串，空查询时按 Ctrl+R 重新使用
+static std::string last_search_query;
+
+/**
+ * @brief 行编辑器状态
+ *
+ * 按键事件由各平台的输入循环解码后交给 apply()，编辑逻辑在 Windows 与 POSIX 之间共用。
+ * 输入不完整（引号或 ${ 未闭合、以反斜杠结尾）时回车插入换行继续输入，缓冲区因此可以有多行，
+ * 上下方向键先在行间移动，到了第一行或最后一行再浏览历史。
+ */
+struct LineEditor {
+    std::string buffer;
+    size_t cursor = 0; // 光标在缓冲区中的字节位置，始终位于字素簇边界
+    LineRenderer renderer;
+    SyntaxHighlighter highlighter;
+    KeyType last_key = KeyType::Enter; // 上一个按键，用于识别连按两次 Tab
+    size_t history_age = 0;  // 正在浏览的历史记录，0 表示正在编辑的新行
+    std::string draft;       // 开始浏览历史前输入的内容
+    std::string prompt;      // 正常编辑时的提示符
+    std::string suggestion;  // 自动提示：光标之后以灰色显示、按右方向键接受的部分
+    bool show_suggestion = true; // 按下回车后不再显示提示
+    bool interrupted = false;    // 按 Ctrl+C 放弃了这一行
+
+    // Ctrl+R 反向增量搜索
+    struct HistorySearch {
+        bool active = false;
+        bool failed = false;
+        std::string query;
+        size_t age = 0;           // 当前匹配的历史记录，0 表示还没有匹配
+        std::string saved_buffer; // 进入搜索前的内容，Ctrl+G 取消时恢复
+        size_t saved_cursor = 0;
+    } search;
+
+    void begin(const std::string& prompt_text) {
+        prompt = prompt_text;
+        renderer.begin(prompt);
+        highlighter.reset();
+    }
+
+    // 提示符在后台更新后原地重绘；搜索时显示的是搜索提示，结束搜索后再换上新的提示符
+    void update_prompt(const std::string& prompt_text) {
+        prompt = prompt_text;
+        if (!search.active) renderer.set_prompt(prompt);
+    }
+
+    // pos 所在行的开头与结尾（不含换行符）
+    size_t line_start(size_t pos) const {
+        size_t newline = pos == 0 ? std::string::npos : buffer.rfind('\n', pos - 1);
+        return newline == std::string::npos ? 0 : newline + 1;
+    }
+
+    size_t line_end(size_t pos) const {
+        return std::min(buffer.find('\n', pos), buffer.size());
+    }
+
+    // 光标移到上一行或下一行中相同显示列的位置，没有这一行时返回 false
+    bool move_vertical(bool up) {
+        size_t start = line_start(cursor);
+        size_t target;
+        if (up) {
+            if (start == 0) return false;
+            target = line_start(start - 1);
+        }
+        else {
+            size_t end = line_end(cursor);
+            if (end == buffer.size()) return false;
+            target = end + 1;
+        }
+
+        size_t column = text_width(buffer, start, cursor);
+        size_t target_end = line_end(target);
+        size_t width = 0;
+        cursor = target;
+        while (cursor < target_end) {
+            size_t next = next_grapheme(buffer, cursor);
+            width += text_width(buffer, cursor, next);
+            if (width > column) break;
+            cursor = next;
+        }
+        return true;
+    }
+
+    // 光标在行尾时取以当前内容开头的最新一条历史作为提示，截断到当前行剩余的宽度内
+    void update_suggestion() {
+        suggestion.clear();
+        if (!show_suggestion || search.active || buffer.empty() || cursor != buffer.size()) return;
+        std::string command;
+        if (!HistoryLog::suggest(buffer, command)) return;
+
+        size_t start = line_start(buffer.size());
+        size_t used = visible_width(start == 0 ? prompt : LineRenderer::continuation_prompt()) +
+                      text_width(buffer, start, buffer.size()) + 1;
+        size_t room = terminal_width() > used ? terminal_width() - used : 0;
+        size_t end = buffer.size();
+        size_t width = 0;
+        while (end < command.size() && command[end] != '\n') {
+            size_t next = next_grapheme(command, end);
+            width += text_width(command, end, next);
+            if (width > room) break;
+            end = next;
+        }
+        suggestion = command.substr(buffer.size(), end - buffer.size());
+    }
+
+    // 光标在行尾且有提示时接受提示
+    bool accept_suggestion() {
+        update_suggestion();
+        if (suggestion.empty()) return false;
+        buffer += suggestion;
+        cursor = buffer.size();
+        return true;
+    }
+
+    // 把当前内容连同高亮和自动提示一起更新到屏幕
+    void render() {
+        update_suggestion();
+        const std::vector<HighlightStyle>& styles = highlighter.update(buffer);
+        if (suggestion.empty()) {
+            renderer.render(buffer, cursor, styles);
+            return;
+        }
+        std::vector<HighlightStyle> shown_styles(styles);
+        shown_styles.resize(buffer.size() + suggestion.size(), HighlightStyle::Suggestion);
+        renderer.render(buffer + suggestion, cursor, shown_styles);
+    }
+
+    void show_search() {
+        renderer.set_prompt(std::string(search.failed ? "(failed reverse-i-search)`" : "(reverse-i-search)`") +
+                            search.query + "': ");
+    }
+
+    // 在第 from 条之前查找匹配；skip_current 时跳过与当前显示内容相同的记录
+    void find_match(size_t from, bool skip_current) {
+        HistoryLog::Entry entry;
+        size_t age = from;
+        while (HistoryLog::search(search.query, age, entry)) {
+            if (skip_current && entry.command == buffer) continue;
+            search.age = age;
+            search.failed = false;
+            buffer = entry.command;
+            cursor = HistoryLog::find_text(buffer, search.query);
+            show_search();
+            return;
+        }
+        search.failed = true;
+        renderer.bell();
+        show_search();
+    }
+
+    void end_search() {
+        if (!search.query.empty()) last_search_query = search.query;
+        search.active = false;
+        renderer.set_prompt(prompt);
+        // 之后的上下键从匹配的位置继续浏览
+        if (search.age > 0) {
+            history_age = search.age;
+            draft = search.saved_buffer;
+        }
+    }
+
+    // 搜索模式下的按键，返回 false 表示接受当前匹配并退出搜索，按键再按普通编辑处理
+    bool apply_search(const KeyEvent& event) {
+        switch (event.type) {
+            case KeyType::Text:
+            case KeyType::Paste:
+                search.query += event.type == KeyType::Paste ? sanitize_paste(event.text) : event.text;
+                // 当前匹配仍包含加长后的查询串时停在原处
+                find_match(search.age > 0 ? search.age - 1 : 0, false);
+                return true;
+
+            case KeyType::Backspace:
+                if (search.query.empty()) return true;
+                search.query.erase(prev_grapheme(search.query, search.query.size()));
+                if (search.query.empty()) {
+                    search.failed = false;
+                    show_search();
+                }
+                else {
+                    find_match(0, false);
+                }
+                return true;
+
+            case KeyType::SearchHistory:
+                // 再按一次 Ctrl+R 查找更早的匹配
+                if (search.query.empty()) search.query = last_search_query;
+                if (search.query.empty()) return true;
+                find_match(search.age, search.age > 0);
+                return true;
+
+            case KeyType::Cancel:
+                buffer = search.saved_buffer;
+                cursor = search.saved_cursor;
+                search.age = 0;
+                end_search();
+                return true;
+
+            default:
+                end_search();
+                return false;
+        }
+    }
+
+    // 应用一个按键，返回 true 表示这一行输入结束
+    bool apply(const KeyEvent& event) {
+        bool repeated_tab = event.type == KeyType::Tab && last_key == KeyType::Tab;
+        last_key = event.type;
+        if (search.active && apply_search(event)) return false;
+
+        switch (event.type) {
+            case KeyType::Text:
+                buffer.insert(cursor, event.text);
+                cursor += event.text.size();
+                break;
+
+            case KeyType::Paste: {
+                std::string text = sanitize_paste(event.text);
+                buffer.insert(cursor, text);
+                cursor += text.size();
+                break;
+            }
+
+            case KeyType::Tab:
+                handle_tab(buffer, cursor, renderer, repeated_tab);
+                break;
+
+            case KeyType::Up: {
+                if (move_vertical(true)) break;
+                // 历史从文件末尾按需向前读取，每次只解码一条记录
+                HistoryLog::Entry entry;
+                if (HistoryLog::get(history_age + 1, entry)) {
+                    if (history_age == 0) draft = buffer;
+                    history_age++;
+                    buffer = entry.command;
+                    cursor = buffer.length();
+                }
+                break;
+            }
+
+            case KeyType::Down:
+                if (move_vertical(false)) break;
+                if (history_age > 0) {
+                    history_age--;
+                    HistoryLog::Entry entry;
+                    if (history_age > 0 && HistoryLog::get(history_age, entry)) {
+                        buffer = entry.command;
+                    } else {
+                        buffer = draft;
+                    }
+                    cursor = buffer.length();
+                }
+                break;
+
+            case KeyType::Left:
+                cursor = prev_grapheme(buffer, cursor);
+                break;
+
+            case KeyType::Right:
+                if (!accept_suggestion()) cursor = next_grapheme(buffer, cursor);
+                break;
+
+            case KeyType::Home:
+                cursor = line_start(cursor);
+                break;
+
+            case KeyType::End:
+                if (line_end(cursor) != buffer.length()) cursor = line_end(cursor);
+                else if (!accept_suggestion()) cursor = buffer.length();
+                break;
+
+            case KeyType::WordLeft:
+                while (cursor > 0 && !is_word_char(buffer[cursor - 1])) cursor--;
+                while (cursor > 0 && is_word_char(buffer[cursor - 1])) cursor--;
+                break;
+
+            case KeyType::WordRight:
+                while (cursor < buffer.length() && !is_word_char(buffer[cursor])) cursor++;
+                while (cursor < buffer.length() && is_word_char(buffer[cursor])) cursor++;
+                break;
+
+            case KeyType::Backspace: {
+                // 按字素簇删除：汉字的多个字节、基字符与组合符号一起删掉
+                size_t start = prev_grapheme(buffer, cursor);
+                buffer.erase(start, cursor - start);
+                cursor = start;
+                break;
+            }
+
+            case KeyType::Delete:
+                buffer.erase(cursor, next_grapheme(buffer, cursor) - cursor);
+                break;
+
+            case KeyType::KillToEnd: {
+                // 已在行尾时删掉换行符，与下一行合并
+                size_t end = line_end(cursor);
+                if (end == cursor && end < buffer.length()) end++;
+                buffer.erase(cursor, end - cursor);
+                break;
+            }
+
+            case KeyType::KillToStart: {
+                size_t start = line_start(cursor);
+                buffer.erase(start, cursor - start);
+                cursor = start;
+                break;
+            }
 
-// 交互式逐字符读取一行，支持在未回车时按下 Ctrl+L 清屏
+            case KeyType::KillWordBack: {
+                // 与 readline 的 unix-word-rubout 相同，以空白为分隔
+                size_t start = cursor;
+                while (start > 0 && buffer[start - 1] == ' ') start--;
+                while (start > 0 && buffer[start - 1] != ' ') start--;
+                buffer.erase(start, cursor - start);
+                cursor = start;
+                break;
+            }
+
+            case KeyType::ClearScreen:
+#ifdef _WIN32
+                system("cls");
+#else
+                if (system("clear") != 0) {
+                    // 忽略错误
+                }
+#endif
+                renderer.invalidate();
+                break;
+
+            case KeyType::SearchHistory:
+                search = HistorySearch{};
+                search.active = true;
+                search.saved_buffer = buffer;
+                search.saved_cursor = cursor;
+                show_search();
+                break;
+
+            case KeyType::Escape:
+            case KeyType::Cancel:
+                break;
+
+            case KeyType::Enter:
+                // ${ 没有闭合或以反斜杠结尾时换行继续输入
+                highlighter.update(buffer);
+                if (highlighter.incomplete()) {
+                    buffer += '\n';
+                    cursor = buffer.length();
+                    break;
+                }
+                show_suggestion = false;
+                return true;
+
+            case KeyType::Interrupt:
+                // 放弃这一行，与 bash 一样在行尾显示 ^C 后换到新的提示符
+                interrupted = true;
+                show_suggestion = false;
+                return true;
+        }
+        return false;
+    }
+};
+
+#ifdef _WIN32
+struct ScanBinding {
+    int code;
+    KeyType key;
+};
+
+// _getch() 在 0 或 0xE0 之后返回的功能键扫描码
+constexpr ScanBinding WINDOWS_SCAN_CODES[] = {
+    {72, KeyType::Up},   {80, KeyType::Down}, {75, KeyType::Left},      {77, KeyType::Right},
+    {71, KeyType::Home}, {79, KeyType::End},  {83, KeyType::Delete},    {115, KeyType::WordLeft},
+    {116, KeyType::WordRight},
+};
+#else
+// 读到单独的 ESC 后等待后续字节的时间，超时即视为单独按下了 ESC 键
+constexpr int ESCAPE_TIMEOUT_MS = 50;
+
+/**
+ * @brief 整个会话共用的输入解码状态
+ *
+ * 一次 read 读到的字节可能包含多行（例如一次发来的多条命令），回车之后剩余的事件留在队列中，
+ * 由下一次 read_line_interactive 先处理；解码器也在两次调用之间保留，未完成的转义序列不会丢失。
+ */
+struct InputQueue {
+    InputDecoder decoder;
+    std::deque<KeyEvent> events;
+};
+
+static InputQueue& input_queue() {
+    static InputQueue queue;
+    return queue;
+}
+#endif
+
+// 交互式读取一行，支持行编辑、历史记录、Tab 补全与 Ctrl+L 清屏
 std::string read_line_interactive(const std::string& prompt_shown) {
-    std::string current_buffer;
-    size_t cursor_pos = 0;  // 光标在缓冲区中的位置
+    LineEditor editor;
+    reset_completion_session();
 
 #ifdef _WIN32
     // 如果不是交互式终端，或者正在调试器中运行，_getch() 可能无法工作
@@ -53,120 +545,45 @@ std::string read_line_interactive(const std::string& prompt_shown) {
     }
 
     // 初始打印 prompt
-    std::cout << prompt_shown;
-    std::cout.flush();
+    editor.begin(prompt_shown);
 
     for (;;) {
         int ch = _getch();
 
         // 处理 EOF 或错误
         if (ch == -1 || ch == 26) { // 26 是 Ctrl+Z
-            if (current_buffer.empty()) return "exit";
-            std::cout << "\n";
+            if (editor.buffer.empty()) return "exit";
+            editor.renderer.finish();
             break;
         }
 
-        // 处理普通回车 (LF)
-        if (ch == '\n') {
-            std::cout << "\n";
-            break;
-        }
-
-        // 特殊键处理 (功能键)
+        KeyEvent event{KeyType::Escape, {}};
         if (ch == 0 || ch == 0xE0) {
-            int ch2 = _getch(); // 获取第二个字节
-
-            if (ch2 == 72) { // 上箭头键
-                if (!command_history.empty() && history_index > 0) {
-                    history_index--;
-                    current_buffer = command_history[history_index];
-                    cursor_pos = current_buffer.length();
-                    // 重绘行
-                    std::cout << "\r" << prompt_shown << current_buffer << "\033[K";
-                    std::cout.flush();
-                }
-                continue;
-            }
-            else if (ch2 == 80) { // 下箭头键
-                if (!command_history.empty() && history_index < command_history.size()) {
-                    history_index++;
-                    if (history_index < command_history.size()) {
-                        current_buffer = command_history[history_index];
-                    } else {
-                        current_buffer.clear();
-                    }
-                    cursor_pos = current_buffer.length();
-                    // 重绘行
-                    std::cout << "\r" << prompt_shown << current_buffer << "\033[K";
-                    std::cout.flush();
-                }
-                continue;
-            }
-            else if (ch2 == 75) { // 左箭头键
-                if (cursor_pos > 0) {
-                    cursor_pos--;
-                    std::cout << "\b";
-                    std::cout.flush();
-                }
-                continue;
-            }
-            else if (ch2 == 77) { // 右箭头键
-                if (cursor_pos < current_buffer.length()) {
-                    cursor_pos++;
-                    std::cout << current_buffer[cursor_pos-1];
-                    std::cout.flush();
-                }
-                continue;
-            }
+            // 功能键：第二个字节为扫描码
+            int code = _getch();
+            auto it = std::find_if(std::begin(WINDOWS_SCAN_CODES), std::end(WINDOWS_SCAN_CODES),
+                                   [code](const ScanBinding& binding) { return binding.code == code; });
+            if (it == std::end(WINDOWS_SCAN_CODES)) continue;
+            event.type = it->key;
         }
-
-        // 回车 (CR)
-        if (ch == '\r') {
-            std::cout << "\n";
-            break;
-        }
-
-        // 处理退格键
-        if (ch == 8 /* BS */ || ch == 127) {
-            if (!current_buffer.empty() && cursor_pos > 0) {
-                current_buffer.erase(cursor_pos - 1, 1);
-                cursor_pos--;
-
-                // 重绘行
-                std::cout << "\r" << prompt_shown << current_buffer << "\033[K";
-                // 将光标移回正确位置
-                for (size_t i = current_buffer.length(); i > cursor_pos; --i) {
-                    std::cout << "\b";
-                }
-                std::cout.flush();
-            }
-            continue;
+        else if (ch == 27) {
+            event.type = KeyType::Escape;
         }
-
-        // 处理 Ctrl+L (FF, 0x0C)
-        if (ch == 12) {
-            system("cls");
-            std::cout << "\r" << prompt_shown << current_buffer;
-            // 将光标移动到正确位置
-            for (size_t i = cursor_pos; i < current_buffer.length(); ++i) {
-                std::cout << "\b";
-            }
-            std::cout.flush();
-            continue;
+        else if (!InputDecoder::control_key(static_cast<unsigned char>(ch), event.type)) {
+            // 忽略不可打印控制字符
+            if (ch < 32) continue;
+            event = {KeyType::Text, std::string(1, static_cast<char>(ch))};
         }
 
-        // 忽略不可打印控制字符
-        if (ch >= 32 && ch != 127) {
-            current_buffer.insert(cursor_pos, 1, static_cast<char>(ch));
-            cursor_pos++;
+        // 后台算出的新提示符在下一次按键时一起更新
+        std::string updated;
+        if (PromptPipeline::poll_update(updated)) editor.update_prompt(updated);
 
-            // 重绘行
-            std::cout << "\r" << prompt_shown << current_buffer << "\033[K";
-            // 将光标移动到正确位置
-            for (size_t i = cursor_pos; i < current_buffer.length(); ++i) {
-                std::cout << "\b";
-            }
-            std::cout.flush();
+        bool done = editor.apply(event);
+        editor.render();
+        if (done) {
+            editor.renderer.finish(editor.interrupted ? "^C" : "");
+            break;
         }
     }
 #else
@@ -179,133 +596,64 @@ std::string read_line_interactive(const std::string& prompt_shown) {
         return "";
     }
 
-    termios oldt{};
-    termios newt{};
-    tcgetattr(STDIN_FILENO, &oldt);
-    newt = oldt;
-    newt.c_lflag &= ~(ICANON); // 保留 ECHO 由我们自己输出
-    newt.c_lflag &= ~(ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+    // 终端在第一次读取时切换到 raw 模式（并开启括号粘贴），之后整个会话保持不变
+    TerminalSession::enter();
+    editor.begin(prompt_shown);
 
-    // 初始打印 prompt
-    std::cout << prompt_shown;
-    std::cout.flush();
+    InputQueue& queue = input_queue();
+    InputDecoder& decoder = queue.decoder;
+    std::vector<KeyEvent> events;
+    bool done = false;
 
-    for (;;) {
-        unsigned char ch = 0;
-        ssize_t n = ::read(STDIN_FILENO, &ch, 1);
-        if (n <= 0) {
-            continue;
-        }
+    while (!done) {
+        // 先处理上一行之后剩下的事件，全部处理完才读取新的输入
+        if (queue.events.empty()) {
+            events.clear();
 
-        // ANSI 转义序列处理 (方向键)
-        if (ch == 27) { // ESC
-            unsigned char ch2 = 0;
-            n = ::read(STDIN_FILENO, &ch2, 1);
-            if (n > 0 && ch2 == '[') {
-                unsigned char ch3 = 0;
-                n = ::read(STDIN_FILENO, &ch3, 1);
-                if (n > 0) {
-                    if (ch3 == 'A') { // 上箭头
-                        if (!command_history.empty() && history_index > 0) {
-                            history_index--;
-                            current_buffer = command_history[history_index];
-                            cursor_pos = current_buffer.length();
-                            std::cout << "\r" << prompt_shown << current_buffer << "\033[K";
-                            std::cout.flush();
-                        }
-                        continue;
-                    }
-                    else if (ch3 == 'B') { // 下箭头
-                        if (!command_history.empty() && history_index < command_history.size()) {
-                            history_index++;
-                            if (history_index < command_history.size()) {
-                                current_buffer = command_history[history_index];
-                            } else {
-                                current_buffer.clear();
-                            }
-                            cursor_pos = current_buffer.length();
-                            std::cout << "\r" << prompt_shown << current_buffer << "\033[K";
-                            std::cout.flush();
-                        }
-                        continue;
-                    }
-                    else if (ch3 == 'D') { // 左箭头
-                        if (cursor_pos > 0) {
-                            cursor_pos--;
-                            std::cout << "\b";
-                            std::cout.flush();
-                        }
-                        continue;
-                    }
-                    else if (ch3 == 'C') { // 右箭头
-                        if (cursor_pos < current_buffer.length()) {
-                            cursor_pos++;
-                            std::cout << current_buffer[cursor_pos-1];
-                            std::cout.flush();
-                        }
+            // 同时等待终端输入和提示符的后台计算；停在 ESC 之后时只短暂等待，后续字节没有到达说明是单独按下的 ESC 键
+            struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {PromptPipeline::wakeup_fd(), POLLIN, 0}};
+            int ready = poll(fds, 2, decoder.pending_escape() ? ESCAPE_TIMEOUT_MS : -1);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready == 0) {
+                decoder.timeout(events);
+            }
+            else {
+                if (ready > 0 && (fds[1].revents & POLLIN)) {
+                    std::string updated;
+                    if (PromptPipeline::poll_update(updated)) editor.update_prompt(updated);
+                    if (!(fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+                        editor.render();
                         continue;
                     }
                 }
-            }
-        }
-
-        if (ch == '\n' || ch == '\r') {
-            std::cout << "\n";
-            break;
-        }
-
-        if (ch == 8 || ch == 127) { // backspace/delete
-            if (!current_buffer.empty() && cursor_pos > 0) {
-                current_buffer.erase(cursor_pos - 1, 1);
-                cursor_pos--;
 
-                // 重绘行
-                std::cout << "\r" << prompt_shown << current_buffer << "\033[K";
-                // 将光标移回正确位置
-                for (size_t i = current_buffer.length(); i > cursor_pos; --i) {
-                    std::cout << "\b";
+                // 按块读取：粘贴或快速输入的多个字节一次读入，处理完整批事件后只重绘一次
+                char chunk[4096];
+                ssize_t n = ::read(STDIN_FILENO, chunk, sizeof(chunk));
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    // 终端已关闭
+                    if (editor.buffer.empty()) editor.buffer = "exit";
+                    editor.renderer.finish();
+                    break;
                 }
-                std::cout.flush();
+                decoder.feed(chunk, static_cast<size_t>(n), events);
             }
-            continue;
+            std::move(events.begin(), events.end(), std::back_inserter(queue.events));
         }
 
-        if (ch == 12) { // Ctrl+L
-#ifdef _WIN32
-            if (system("cls") != 0) {
-                // 忽略错误
-            }
-#else
-            if (system("clear") != 0) {
-                // 忽略错误
-            }
-#endif
-            std::cout << "\r" << prompt_shown << current_buffer;
-            // 将光标移动到正确位置
-            for (size_t i = cursor_pos; i < current_buffer.length(); ++i) {
-                std::cout << "\b";
-            }
-            std::cout.flush();
-            continue;
+        // 回车结束这一行时停下，之后的事件属于下一行
+        while (!done && !queue.events.empty()) {
+            KeyEvent event = std::move(queue.events.front());
+            queue.events.pop_front();
+            done = editor.apply(event);
         }
 
-        if (ch >= 32 && ch != 127) {
-            current_buffer.insert(cursor_pos, 1, static_cast<char>(ch));
-            cursor_pos++;
-
-            // 重绘行
-            std::cout << "\r" << prompt_shown << current_buffer << "\033[K";
-            // 将光标移动到正确位置
-            for (size_t i = cursor_pos; i < current_buffer.length(); ++i) {
-                std::cout << "\b";
-            }
-            std::cout.flush();
-        }
+        editor.render();
+        if (done) editor.renderer.finish(editor.interrupted ? "^C" : "");
     }
-
-    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
 #endif
 
-    return current_buffer;
-}
\ No newline at end of file
+    if (editor.interrupted) return "";
+    return join_continued_lines(editor.buffer);
+}
@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include "../header.h"
+#include "shell_listing.h"
+#include "dir_cache.h"
+#include "shell_path.h"
+#include "terminal_session.h"
+#include "unicode_width.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+struct ListOptions {
+    bool long_format = false;
+    bool all = false;
+    bool sort_size = false;
+    bool sort_time = false;
+    bool recursive = false;
+};
+
+#ifndef _WIN32
+
+static EntryType type_from_mode(mode_t mode) {
+    if (S_ISDIR(mode)) return EntryType::Directory;
+    if (S_ISREG(mode)) return EntryType::File;
+    if (S_ISLNK(mode)) return EntryType::Symlink;
+    return EntryType::Other;
+}
+
+static EntryType type_from_dtype(unsigned char d_type) {
+    switch (d_type) {
+        case DT_DIR: return EntryType::Directory;
+        case DT_REG: return EntryType::File;
+        case DT_LNK: return EntryType::Symlink;
+        case DT_UNKNOWN: return EntryType::Unknown;
+        default: return EntryType::Other;
+    }
+}
+
+// 只在需要时调用：长格式、按大小/时间排序，或文件系统不提供 d_type
+static bool stat_entry(int dir_fd, DirEntryInfo& entry) {
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+    struct statx stx{};
+    if (statx(dir_fd, entry.name.c_str(), AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+              STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME, &stx) != 0) {
+        return false;
+    }
+    entry.mode = stx.stx_mode;
+    entry.size = stx.stx_size;
+    entry.mtime_sec = stx.stx_mtime.tv_sec;
+    entry.mtime_nsec = stx.stx_mtime.tv_nsec;
+#else
+    struct stat st{};
+    if (fstatat(dir_fd, entry.name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        return false;
+    }
+    entry.mode = st.st_mode;
+    entry.size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+    entry.mtime_sec = st.st_mtimespec.tv_sec;
+    entry.mtime_nsec = st.st_mtimespec.tv_nsec;
+#else
+    entry.mtime_sec = st.st_mtim.tv_sec;
+    entry.mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+#endif
+    entry.type = type_from_mode(static_cast<mode_t>(entry.mode));
+    entry.has_stat = true;
+    return true;
+}
+
+#ifdef __linux__
+// getdents64 返回的原始记录格式
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+#endif
+
+static void append_entry(std::vector<DirEntryInfo>& entries, const char* name, unsigned char d_type) {
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) return;
+    DirEntryInfo entry;
+    entry.name = name;
+    entry.type = type_from_dtype(d_type);
+    entries.push_back(std::move(entry));
+}
+
+bool read_directory(const std::string& path, bool with_stat, std::vector<DirEntryInfo>& entries) {
+    int dir_fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) return false;
+
+#ifdef __linux__
+    // 大缓冲区一次取回尽可能多的目录项，百万级目录只需少量系统调用
+    std::vector<char> buffer(1 << 20);
+    for (;;) {
+        long n = syscall(SYS_getdents64, dir_fd, buffer.data(), buffer.size());
+        if (n < 0) {
+            int err = errno;
+            close(dir_fd);
+            errno = err;
+            return false;
+        }
+        if (n == 0) break;
+        for (long offset = 0; offset < n;) {
+            auto* record = reinterpret_cast<linux_dirent64*>(buffer.data() + offset);
+            append_entry(entries, record->d_name, record->d_type);
+            offset += record->d_reclen;
+        }
+    }
+#else
+    DIR* dir = fdopendir(dup(dir_fd));
+    if (!dir) {
+        close(dir_fd);
+        return false;
+    }
+    struct dirent* record;
+    while ((record = readdir(dir)) != nullptr) {
+        append_entry(entries, record->d_name, record->d_type);
+    }
+    closedir(dir);
+#endif
+
+    for (auto& entry : entries) {
+        if (with_stat || entry.type == EntryType::Unknown) {
+            stat_entry(dir_fd, entry);
+        }
+    }
+    close(dir_fd);
+    return true;
+}
+
+static bool stdout_is_terminal() {
+    return isatty(STDOUT_FILENO) != 0;
+}
+
+// 整个列表拼接完毕后一次性写出，避免逐行 flush
+static void write_output(const std::string& out) {
+    std::cout.flush();
+    size_t written = 0;
+    while (written < out.size()) {
+        ssize_t n = ::write(STDOUT_FILENO, out.data() + written, out.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+}
+
+#else // _WIN32
+
+bool read_directory(const std::string& path, bool with_stat, std::vector<DirEntryInfo>& entries) {
+    (void)with_stat; // FindFirstFile 已经附带了所有信息
+    WIN32_FIND_DATAA findData;
+    HANDLE hFind = FindFirstFileA((path + "\\*").c_str(), &findData);
+    if (hFind == INVALID_HANDLE_VALUE) return false;
+
+    do {
+        std::string name(findData.cFileName);
+        if (name == "." || name == "..") continue;
+
+        DirEntryInfo entry;
+        entry.name = name;
+        if (findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) entry.type = EntryType::Symlink;
+        else if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) entry.type = EntryType::Directory;
+        else entry.type = EntryType::File;
+        entry.size = (static_cast<uint64_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+
+        // FILETIME 为 1601 年起的 100ns 计数，转换为 Unix 时间
+        uint64_t ticks = (static_cast<uint64_t>(findData.ftLastWriteTime.dwHighDateTime) << 32) |
+                         findData.ftLastWriteTime.dwLowDateTime;
+        entry.mtime_sec = static_cast<int64_t>(ticks / 10000000ULL) - 11644473600LL;
+        entry.mtime_nsec = static_cast<int64_t>(ticks % 10000000ULL) * 100;
+        entry.has_stat = true;
+        entries.push_back(std::move(entry));
+    }
+    while (FindNextFileA(hFind, &findData));
+    FindClose(hFind);
+    return true;
+}
+
+static bool stdout_is_terminal() {
+    return _isatty(_fileno(stdout)) != 0;
+}
+
+static void write_output(const std::string& out) {
+    std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+    std::cout.flush();
+}
+
+#endif // _WIN32
+
+size_t terminal_width() {
+    return TerminalSession::columns();
+}
+
+// 缓存中的列表是共享只读的，排序和过滤都在指针视图上进行
+using EntryView = std::vector<const DirEntryInfo*>;
+
+static void sort_entries(EntryView& entries, const ListOptions& opts) {
+    if (opts.sort_size) {
+        std::sort(entries.begin(), entries.end(), [](const DirEntryInfo* a, const DirEntryInfo* b) {
+            if (a->size != b->size) return a->size > b->size;
+            return a->name < b->name;
+        });
+    }
+    else if (opts.sort_time) {
+        std::sort(entries.begin(), entries.end(), [](const DirEntryInfo* a, const DirEntryInfo* b) {
+            if (a->mtime_sec != b->mtime_sec) return a->mtime_sec > b->mtime_sec;
+            if (a->mtime_nsec != b->mtime_nsec) return a->mtime_nsec > b->mtime_nsec;
+            return a->name < b->name;
+        });
+    }
+    else {
+        std::sort(entries.begin(), entries.end(), [](const DirEntryInfo* a, const DirEntryInfo* b) {
+            return a->name < b->name;
+        });
+    }
+}
+
+static void append_name(std::string& out, const DirEntryInfo& entry, bool color) {
+    if (!color) {
+        out += entry.name;
+        return;
+    }
+    const std::string* style = nullptr;
+    if (entry.type == EntryType::Directory) style = &BLUE;
+    else if (entry.type == EntryType::Symlink) style = &CYAN;
+    else if (entry.has_stat && entry.type == EntryType::File && (entry.mode & 0111)) style = &GREEN;
+
+    if (style) {
+        out += BOLD;
+        out += *style;
+        out += entry.name;
+        out += RESET;
+    }
+    else {
+        out += entry.name;
+    }
+}
+
+static void format_long(std::string& out, const EntryView& entries, bool color) {
+    size_t size_width = 1;
+    for (const auto* entry : entries) {
+        size_width = std::max(size_width, std::to_string(entry->size).length());
+    }
+
+    for (const auto* entry_ptr : entries) {
+        const DirEntryInfo& entry = *entry_ptr;
+        switch (entry.type) {
+            case EntryType::Directory: out += "<DIR>   "; break;
+            case EntryType::Symlink:   out += "<LINK>  "; break;
+            case EntryType::File:      out += "<FILE>  "; break;
+            default:                   out += "<OTHER> "; break;
+        }
+
+        std::string size = std::to_string(entry.size);
+        out.append(size_width - size.length(), ' ');
+        out += size;
+
+        char time_buf[32] = "";
+        time_t mtime = static_cast<time_t>(entry.mtime_sec);
+        struct tm tm_buf{};
+#ifdef _WIN32
+        localtime_s(&tm_buf, &mtime);
+#else
+        localtime_r(&mtime, &tm_buf);
+#endif
+        strftime(time_buf, sizeof(time_buf), " %Y-%m-%d %H:%M ", &tm_buf);
+        out += time_buf;
+
+        append_name(out, entry, color);
+        out += '\n';
+    }
+}
+
+// 与 ls 相同的按列排布：先竖向填充，再选择能放进终端宽度的最多列数
+static void format_columns(std::string& out, const EntryView& entries, bool color) {
+    if (entries.empty()) return;
+
+    std::vector<size_t> widths;
+    widths.reserve(entries.size());
+    for (const auto* entry : entries) widths.push_back(text_width(entry->name));
+
+    const size_t gap = 2;
+    const size_t line_width = terminal_width();
+    const size_t max_cols = std::max<size_t>(1, std::min(entries.size(), line_width / (1 + gap)));
+
+    size_t cols = 1;
+    std::vector<size_t> col_widths;
+    for (size_t try_cols = max_cols; try_cols >= 1; --try_cols) {
+        size_t rows = (entries.size() + try_cols - 1) / try_cols;
+        // 行数相同的列数中只需尝试最少的那种
+        if (try_cols > 1 && (entries.size() + try_cols - 2) / (try_cols - 1) == rows) continue;
+
+        std::vector<size_t> candidate((entries.size() + rows - 1) / rows, 0);
+        size_t total = 0;
+        bool fits = true;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            size_t col = i / rows;
+            candidate[col] = std::max(candidate[col], widths[i]);
+        }
+        for (size_t col = 0; col < candidate.size(); ++col) {
+            total += candidate[col] + (col + 1 < candidate.size() ? gap : 0);
+            if (total > line_width) {
+                fits = false;
+                break;
+            }
+        }
+        if (fits || try_cols == 1) {
+            cols = candidate.size();
+            col_widths = std::move(candidate);
+            break;
+        }
+    }
+
+    size_t rows = (entries.size() + cols - 1) / cols;
+    for (size_t row = 0; row < rows; ++row) {
+        for (size_t col = 0; col < cols; ++col) {
+            size_t i = col * rows + row;
+            if (i >= entries.size()) break;
+            append_name(out, *entries[i], color);
+            bool last = col + 1 == cols || (col + 1) * rows + row >= entries.size();
+            if (!last) out.append(col_widths[col] - widths[i] + gap, ' ');
+        }
+        out += '\n';
+    }
+}
+
+// 读取 ls 要显示的目录内容，长格式和按大小、时间排序时需要 stat 信息
+static std::shared_ptr<const DirListing> read_listing(const std::string& path, const ListOptions& opts) {
+    return DirCache::get(path, opts.long_format || opts.sort_size || opts.sort_time);
+}
+
+static bool list_directory(std::string& out, const std::string& path, const DirListing& listing,
+                           const std::string& header, const ListOptions& opts, bool color, bool columns) {
+    EntryView entries;
+    entries.reserve(listing.size());
+    for (const auto& entry : listing) {
+        if (opts.all || entry.name[0] != '.') entries.push_back(&entry);
+    }
+    sort_entries(entries, opts);
+
+    if (!header.empty()) out += header + ":\n";
+    if (opts.long_format) format_long(out, entries, color);
+    else if (columns) format_columns(out, entries, color);
+    else {
+        for (const auto* entry : entries) {
+            append_name(out, *entry, color);
+            out += '\n';
+        }
+    }
+
+    bool ok = true;
+    if (opts.recursive) {
+        for (const auto* entry : entries) {
+            if (entry->type != EntryType::Directory) continue;
+            std::string child = path_join(path, entry->name);
+            out += '\n';
+            auto child_listing = read_listing(child, opts);
+            if (!child_listing) {
+                out += RED + BOLD + "Cannot open directory " + child + RESET + "\n";
+                ok = false;
+                continue;
+            }
+            ok = list_directory(out, child, *child_listing, child, opts, color, columns) && ok;
+        }
+    }
+    return ok;
+}
+
+int builtin_list(const std::vector<std::string>& cmd) {
+    ListOptions opts;
+    std::vector<std::string> paths;
+    for (size_t i = 1; i < cmd.size(); ++i) {
+        const std::string& arg = cmd[i];
+        if (arg.length() > 1 && arg[0] == '-') {
+            for (size_t j = 1; j < arg.length(); ++j) {
+                switch (arg[j]) {
+                    case 'l': opts.long_format = true; break;
+                    case 'a': opts.all = true; break;
+                    case 'S': opts.sort_size = true; break;
+                    case 't': opts.sort_time = true; break;
+                    case 'R': opts.recursive = true; break;
+                    default:
+                        println(RED << BOLD << "Unknown option: -" << arg[j] << RESET);
+                        println("Usage: { ls | dir | ListFiles } [-l] [-a] [-S] [-t] [-R] [path...]");
+                        return 1;
+                }
+            }
+        }
+        else {
+            paths.push_back(resolve_path(arg));
+        }
+    }
+    if (paths.empty()) paths.push_back(dir_now);
+
+    const bool terminal = stdout_is_terminal();
+    const bool show_headers = paths.size() > 1 || opts.recursive;
+
+    std::string out;
+    bool ok = true;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (i > 0) out += '\n';
+        // 目录优先走缓存，只有不是目录时才需要 stat；取到的内容直接用于显示，不再读第二次
+        if (auto listing = read_listing(paths[i], opts)) {
+            ok = list_directory(out, paths[i], *listing, show_headers ? paths[i] : "", opts, terminal, terminal) && ok;
+            continue;
+        }
+        struct stat info{};
+        if (stat(paths[i].c_str(), &info) != 0) {
+            out += RED + BOLD + "No such file or directory: " + paths[i] + RESET + "\n";
+            ok = false;
+        }
+        else if ((info.st_mode & S_IFMT) == S_IFDIR) { // 即 S_ISDIR，MSVC 没有定义该宏
+            out += RED + BOLD + "Cannot open directory " + paths[i] + RESET + "\n";
+            ok = false;
+        }
+        else {
+            out += paths[i] + "\n";
+        }
+    }
+    write_output(out);
+    return ok ? 0 : 1;
+}
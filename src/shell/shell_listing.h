@@ -0,0 +1,39 @@
+#ifndef SHELL_LISTING_H
+#define SHELL_LISTING_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class EntryType : unsigned char { Unknown, File, Directory, Symlink, Other };
+
+/**
+ * @brief 目录项信息
+ *
+ * 名称和类型来自目录读取本身（d_type），其余字段只有 has_stat 为 true 时才有效。
+ */
+struct DirEntryInfo {
+    std::string name;
+    EntryType type = EntryType::Unknown;
+    bool has_stat = false;
+    uint32_t mode = 0;
+    uint64_t size = 0;
+    int64_t mtime_sec = 0;
+    int64_t mtime_nsec = 0;
+};
+
+/**
+ * @brief 读取目录内容（不含 "." 与 ".."）
+ * @param path 目录绝对路径
+ * @param with_stat 是否为每一项补充 stat 信息（大小、时间、权限）
+ * @param entries 输出结果，按目录中的原始顺序
+ * @return 目录是否读取成功
+ */
+bool read_directory(const std::string& path, bool with_stat, std::vector<DirEntryInfo>& entries);
+
+// 终端宽度（列数），无法获取时返回 80；只在窗口大小变化后重新查询
+size_t terminal_width();
+
+int builtin_list(const std::vector<std::string>& cmd);
+
+#endif // SHELL_LISTING_H
@@ -1,20 +1,30 @@
 #include <algorithm>
 #include <iomanip>
 #include <cctype>
-#include <deque>
+#include <chrono>
+#include <ctime>
 #include <vector>
 #include <sstream>
 #include <cstdint>
 #include <regex>
 
 #include "../header.h"
+#include "history_log.h"
+#include "prompt_pipeline.h"
 #include "shell_commands.h"
 #include "shell_input.h"
+#include "terminal_session.h"
 #include "../plugins/plugin_manager.h"
 #include "../plugins/plugins_interface.h"
-#include <deque>
 #include <string>
 
+// 记录到历史中（与上一条相同的命令不重复记录）
+static void record_history(const HistoryLog::Entry& entry) {
+    HistoryLog::Entry last;
+    if (HistoryLog::get(1, last) && last.command == entry.command) return;
+    HistoryLog::append(entry);
+}
+
 /**
  * The startup function for DuckShell includes no input parameter and yes parameters and returns an exit code.
  * @param param
@@ -24,45 +34,43 @@ int startup(const std::string &param) {
     if (param.empty()) {
         std::string command;
         while (true) {
-            std::string custom_prompt = "";
-            // 尝试从已加载的插件中获取 prompt
-            for (auto plugin : loaded_plugin_instances) {
-                std::string p = plugin->get_prompt();
-                if (!p.empty()) {
-                    custom_prompt = p;
-                    break; // 使用第一个提供 prompt 的插件
-                }
-            }
+            // 插件段在后台计算，超过期限时先显示缓存的提示符
+            const std::string prompt = PromptPipeline::current();
 
-            const std::string prompt = custom_prompt.empty() 
-                ? (std::string("DUCKSHELL { ") + dir_now + " }> ")
-                : custom_prompt;
-                
+            // 显示提示符前先读入其他会话新追加的历史
+            HistoryLog::refresh();
             command = read_line_interactive(prompt);
-
-            // 添加命令到历史记录（除非是空命令或与上一条相同）
-            if (!command.empty() && (command_history.empty() || command_history.back() != command)) {
-                command_history.push_back(command);
-                if (command_history.size() > 100) {
-                    command_history.pop_front();
-                }
+            if (command.empty()) {
+                continue;
             }
-            history_index = command_history.size();
+
+            HistoryLog::Entry entry;
+            entry.command = command;
+            entry.timestamp = static_cast<int64_t>(std::time(nullptr));
 
             if (command == "exit" || command == "quit") {
+                record_history(entry);
                 break;
             }
 
-            if (!command.empty()) {
-                if (const int exit_code = execute_command(command); exit_code != 0) {
-                    // TODO
-                }
-                // 在执行完一条命令后，打印一个换行符，
-                // 确保下一个 prompt 之前有明显的间隔，
-                // 并且确保子进程的所有异步输出都已经落地。
-                std::cout.flush();
-                std::cerr.flush();
+            // 插件不要求线程安全，命令执行期间后台不调用 get_prompt()
+            PromptPipeline::command_started();
+            const auto started = std::chrono::steady_clock::now();
+            {
+                // 命令执行期间终端交给前台程序
+                TerminalSession::Foreground foreground;
+                entry.exit_code = execute_command(command);
             }
+            PromptPipeline::command_executed();
+            entry.duration_ms = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - started).count());
+            record_history(entry);
+
+            // 在执行完一条命令后，打印一个换行符，
+            // 确保下一个 prompt 之前有明显的间隔，
+            // 并且确保子进程的所有异步输出都已经落地。
+            std::cout.flush();
+            std::cerr.flush();
         }
     }
     else {
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <deque>
+#include <iomanip>
+
+#include "../header.h"
+#include "frecency_db.h"
+#include "shell_navigation.h"
+#include "shell_path.h"
+
+// 目录栈，front 为栈顶；当前目录本身不在栈中（对应 dirs 输出的第 0 项）
+static std::deque<std::string> dir_stack;
+
+int change_directory(const std::string& target) {
+    std::string new_path = normalize_path(resolve_path(target));
+
+    if (!is_directory_exists(new_path)) {
+        println(RED << BOLD << "Directory does not exist." << RESET);
+        return 1;
+    }
+
+#ifdef _WIN32
+    // On Windows, correct the case of each path component and uppercase drive letter
+    // using WinAPI. This ensures paths like "c:\windows" or "C:\WINDOWS" display as
+    // "C:\Windows" consistently.
+    #ifndef MAX_PATH
+    #define MAX_PATH 260
+    #endif
+    char fullBuf[MAX_PATH];
+    DWORD flen = GetFullPathNameA(new_path.c_str(), MAX_PATH, fullBuf, nullptr);
+    std::string full = (flen > 0 && flen < MAX_PATH) ? std::string(fullBuf, flen) : new_path;
+
+    char longBuf[MAX_PATH];
+    DWORD llen = GetLongPathNameA(full.c_str(), longBuf, MAX_PATH);
+    std::string cased = (llen > 0 && llen < MAX_PATH) ? std::string(longBuf, llen) : full;
+
+    if (!cased.empty() && std::isalpha(static_cast<unsigned char>(cased[0]))) {
+        cased[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(cased[0])));
+    }
+    dir_now = cased;
+#else
+    dir_now = new_path;
+#endif
+
+    FrecencyDb::record_visit(dir_now);
+    return 0;
+}
+
+// 主目录下的路径显示为 ~ 开头
+static std::string abbreviate_home(const std::string& path) {
+    if (!home_dir.empty() && path.compare(0, home_dir.size(), home_dir) == 0 &&
+        (path.size() == home_dir.size() || path[home_dir.size()] == '/' || path[home_dir.size()] == '\\')) {
+        return "~" + path.substr(home_dir.size());
+    }
+    return path;
+}
+
+static void print_stack(bool verbose, bool full_paths) {
+    std::vector<std::string> all;
+    all.push_back(dir_now);
+    all.insert(all.end(), dir_stack.begin(), dir_stack.end());
+
+    if (verbose) {
+        for (size_t i = 0; i < all.size(); ++i) {
+            println(std::setw(2) << i << "  " << (full_paths ? all[i] : abbreviate_home(all[i])));
+        }
+        return;
+    }
+    std::string line;
+    for (const auto& path : all) {
+        if (!line.empty()) line += ' ';
+        line += full_paths ? path : abbreviate_home(path);
+    }
+    println(line);
+}
+
+// 解析 +N / -N：返回在 [当前目录, 栈...] 中的下标，失败返回 -1
+static long parse_stack_index(const std::string& arg) {
+    if (arg.size() < 2 || (arg[0] != '+' && arg[0] != '-')) return -1;
+    if (!std::all_of(arg.begin() + 1, arg.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+        return -1;
+    }
+    long n = 0;
+    auto result = std::from_chars(arg.data() + 1, arg.data() + arg.size(), n);
+    if (result.ec != std::errc()) return -1; // 超出 long 范围同样视为越界
+    long count = static_cast<long>(dir_stack.size()) + 1;
+    if (n >= count) return -1;
+    return arg[0] == '+' ? n : count - 1 - n;
+}
+
+int builtin_pushd(const std::vector<std::string>& cmd) {
+    if (cmd.size() > 2) {
+        println(RED << BOLD << "Too many arguments." << RESET);
+        return 1;
+    }
+
+    // 无参数：交换当前目录与栈顶
+    if (cmd.size() == 1) {
+        if (dir_stack.empty()) {
+            println(RED << BOLD << "pushd: no other directory" << RESET);
+            return 1;
+        }
+        std::string previous = dir_now;
+        if (change_directory(dir_stack.front()) != 0) return 1;
+        dir_stack.front() = previous;
+        print_stack(false, false);
+        return 0;
+    }
+
+    // +N / -N：把第 N 项旋转到栈顶
+    if ((cmd[1][0] == '+' || cmd[1][0] == '-') && cmd[1].size() > 1) {
+        long index = parse_stack_index(cmd[1]);
+        if (index < 0) {
+            println(RED << BOLD << "pushd: " << cmd[1] << ": directory stack index out of range" << RESET);
+            return 1;
+        }
+        std::deque<std::string> all(dir_stack);
+        all.push_front(dir_now);
+        std::rotate(all.begin(), all.begin() + index, all.end());
+        if (change_directory(all.front()) != 0) return 1;
+        all.pop_front();
+        dir_stack = std::move(all);
+        print_stack(false, false);
+        return 0;
+    }
+
+    std::string previous = dir_now;
+    if (change_directory(cmd[1]) != 0) return 1;
+    dir_stack.push_front(previous);
+    print_stack(false, false);
+    return 0;
+}
+
+int builtin_popd(const std::vector<std::string>& cmd) {
+    if (cmd.size() > 2) {
+        println(RED << BOLD << "Too many arguments." << RESET);
+        return 1;
+    }
+    if (dir_stack.empty()) {
+        println(RED << BOLD << "popd: directory stack empty" << RESET);
+        return 1;
+    }
+
+    // +N / -N：只从栈中删除第 N 项，+0 等同于无参数
+    long index = 0;
+    if (cmd.size() == 2) {
+        index = parse_stack_index(cmd[1]);
+        if (index < 0) {
+            println(RED << BOLD << "popd: " << cmd[1] << ": invalid argument" << RESET);
+            return 1;
+        }
+    }
+
+    if (index == 0) {
+        if (change_directory(dir_stack.front()) != 0) return 1;
+        dir_stack.pop_front();
+    }
+    else {
+        dir_stack.erase(dir_stack.begin() + (index - 1));
+    }
+    print_stack(false, false);
+    return 0;
+}
+
+int builtin_dirs(const std::vector<std::string>& cmd) {
+    bool verbose = false;
+    bool full_paths = false;
+    for (size_t i = 1; i < cmd.size(); ++i) {
+        if (cmd[i] == "-c") {
+            dir_stack.clear();
+            return 0;
+        }
+        if (cmd[i] == "-v") verbose = true;
+        else if (cmd[i] == "-l") full_paths = true;
+        else {
+            println("Usage: dirs [-c] [-l] [-v]\n"
+                    "    -c    Clear the directory stack.\n"
+                    "    -l    Show full paths instead of ~ abbreviations.\n"
+                    "    -v    Print one entry per line with its stack index.");
+            return 1;
+        }
+    }
+    print_stack(verbose, full_paths);
+    return 0;
+}
+
+int builtin_jump(const std::vector<std::string>& cmd) {
+    bool list_only = false;
+    std::vector<std::string> fragments;
+    for (size_t i = 1; i < cmd.size(); ++i) {
+        if (cmd[i] == "-l") list_only = true;
+        else fragments.push_back(cmd[i]);
+    }
+
+    // 不带片段时列出数据库内容
+    if (fragments.empty()) list_only = true;
+
+    std::vector<FrecencyDb::Match> matches = FrecencyDb::query(fragments);
+    if (list_only) {
+        // 与 z 一致：得分最高的排在最后，靠近提示符
+        for (auto it = matches.rbegin(); it != matches.rend(); ++it) {
+            println(std::left << std::setw(10) << static_cast<long long>(it->score) << std::right
+                              << abbreviate_home(it->path));
+        }
+        return matches.empty() && !fragments.empty() ? 1 : 0;
+    }
+
+    for (const auto& match : matches) {
+        if (match.path == dir_now) continue;
+        // 已删除的目录顺便从数据库中移除
+        if (!is_directory_exists(match.path)) {
+            FrecencyDb::forget(match.path);
+            continue;
+        }
+        return change_directory(match.path);
+    }
+    println(RED << BOLD << "j: no match found." << RESET);
+    return 1;
+}
@@ -0,0 +1,23 @@
+#ifndef SHELL_NAVIGATION_H
+#define SHELL_NAVIGATION_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief 切换当前目录
+ *
+ * 解析相对路径与 ~，规范化后检查目录是否存在，成功时更新 dir_now
+ * 并在访问频率数据库中记录一次访问。
+ * @return 0 表示成功，1 表示目录不存在
+ */
+int change_directory(const std::string& target);
+
+int builtin_pushd(const std::vector<std::string>& cmd);
+int builtin_popd(const std::vector<std::string>& cmd);
+int builtin_dirs(const std::vector<std::string>& cmd);
+
+// j [-l] <fragments...>：跳转到匹配片段且访问频率最高的目录
+int builtin_jump(const std::vector<std::string>& cmd);
+
+#endif // SHELL_NAVIGATION_H
@@ -0,0 +1,95 @@
+#include <vector>
+
+#include "../header.h"
+#include "shell_path.h"
+
+std::string resolve_path(const std::string& path) {
+    if (path.empty()) return dir_now;
+
+    // Absolute path
+    if (path[0] == '/' || (path.length() >= 2 && path[1] == ':')) {
+        return path;
+    }
+#ifdef _WIN32
+    if (path[0] == '\\') return path;
+#endif
+
+    // ~ 展开为用户主目录
+    if (path[0] == '~' && (path.length() == 1 || path[1] == '/' || path[1] == '\\')) {
+        return home_dir + path.substr(1);
+    }
+
+    // Relative path
+    return path_join(dir_now, path);
+}
+
+std::string normalize_path(const std::string& path) {
+    if (path.empty()) return path;
+
+    // Windows 盘符（如 "C:"）单独保留，其后紧跟分隔符表示从该盘根目录开始
+    std::string drive_prefix;
+    size_t pos = 0;
+#ifdef _WIN32
+    if (path.size() >= 2 && path[1] == ':') {
+        drive_prefix = path.substr(0, 2);
+        pos = 2;
+    }
+#endif
+    bool rooted = pos < path.size() && (path[pos] == '/' || path[pos] == '\\');
+
+    std::vector<std::string> segments;
+    while (pos < path.size()) {
+        size_t end = path.find_first_of("/\\", pos);
+        if (end == std::string::npos) end = path.size();
+        std::string token = path.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (token.empty() || token == ".") continue;
+        if (token == "..") {
+            if (!segments.empty()) segments.pop_back();
+            continue;
+        }
+        segments.push_back(std::move(token));
+    }
+
+    std::string result = drive_prefix;
+    if (rooted) result.push_back(PATH_SEPARATOR);
+    for (const auto& segment : segments) {
+        if (!result.empty() && result.back() != PATH_SEPARATOR) result.push_back(PATH_SEPARATOR);
+        result += segment;
+    }
+    return result;
+}
+
+std::string path_join(const std::string& base, const std::string& name) {
+    if (base.empty()) return name;
+    if (base.back() == '/' || base.back() == '\\') {
+        return base + name;
+    }
+    return base + PATH_SEPARATOR + name;
+}
+
+std::string path_basename(const std::string& path) {
+    size_t end = path.find_last_not_of("/\\");
+    if (end == std::string::npos) return path.empty() ? path : path.substr(0, 1);
+    size_t start = path.find_last_of("/\\", end);
+    start = (start == std::string::npos) ? 0 : start + 1;
+    return path.substr(start, end - start + 1);
+}
+
+std::string path_dirname(const std::string& path) {
+    size_t end = path.find_last_not_of("/\\");
+    if (end == std::string::npos) return path.empty() ? "." : path.substr(0, 1);
+    size_t sep = path.find_last_of("/\\", end);
+    if (sep == std::string::npos) return ".";
+
+    // 合并连续的分隔符，但保留根目录
+    size_t last = path.find_last_not_of("/\\", sep);
+    if (last == std::string::npos) return path.substr(0, 1);
+    std::string parent = path.substr(0, last + 1);
+#ifdef _WIN32
+    // "C:" 需要保留为 "C:\"，否则表示该盘的当前目录
+    if (parent.length() == 2 && parent[1] == ':') parent += PATH_SEPARATOR;
+#endif
+    return parent;
+}
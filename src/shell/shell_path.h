@@ -0,0 +1,27 @@
+#ifndef SHELL_PATH_H
+#define SHELL_PATH_H
+
+#include <string>
+
+#ifdef _WIN32
+constexpr char PATH_SEPARATOR = '\\';
+#else
+constexpr char PATH_SEPARATOR = '/';
+#endif
+
+// 将用户输入的路径解析为绝对路径（相对路径基于 dir_now）
+std::string resolve_path(const std::string& path);
+
+// 规范化绝对路径：统一分隔符，消去 "." 与 ".." 段（根目录之上的 ".." 被忽略）
+std::string normalize_path(const std::string& path);
+
+// 拼接目录与名称，避免出现重复的分隔符
+std::string path_join(const std::string& base, const std::string& name);
+
+// 取路径最后一段（忽略末尾的分隔符）
+std::string path_basename(const std::string& path);
+
+// 取父目录路径，没有分隔符时返回 "."
+std::string path_dirname(const std::string& path);
+
+#endif // SHELL_PATH_H
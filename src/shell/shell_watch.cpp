@@ -0,0 +1,455 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <sys/stat.h>
+
+#include "../header.h"
+#include "shell_commands.h"
+#include "shell_listing.h"
+#include "shell_path.h"
+#include "shell_watch.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+// ---------------- Ctrl+C 处理 ----------------
+// 循环期间临时接管 SIGINT：前台子进程照常被终止，shell 本身只退出循环
+
+static volatile std::sig_atomic_t watch_interrupted = 0;
+#ifdef __linux__
+static int interrupt_pipe_write = -1;
+#endif
+
+static void on_watch_interrupt(int) {
+    watch_interrupted = 1;
+#ifdef __linux__
+    if (interrupt_pipe_write >= 0) {
+        char c = 1;
+        (void)!::write(interrupt_pipe_write, &c, 1);
+    }
+#endif
+}
+
+class InterruptScope {
+public:
+    InterruptScope() {
+        watch_interrupted = 0;
+#ifdef __linux__
+        if (pipe2(pipe_fds, O_NONBLOCK | O_CLOEXEC) == 0) {
+            interrupt_pipe_write = pipe_fds[1];
+        }
+#endif
+        previous = std::signal(SIGINT, on_watch_interrupt);
+    }
+
+    ~InterruptScope() {
+        std::signal(SIGINT, previous == SIG_ERR ? SIG_DFL : previous);
+#ifdef __linux__
+        interrupt_pipe_write = -1;
+        if (pipe_fds[0] >= 0) close(pipe_fds[0]);
+        if (pipe_fds[1] >= 0) close(pipe_fds[1]);
+#endif
+    }
+
+    InterruptScope(const InterruptScope&) = delete;
+    InterruptScope& operator=(const InterruptScope&) = delete;
+
+#ifdef __linux__
+    int read_fd() const { return pipe_fds[0]; }
+#endif
+
+private:
+    void (*previous)(int) = SIG_DFL;
+#ifdef __linux__
+    int pipe_fds[2] = {-1, -1};
+#endif
+};
+
+static std::string join_args(const std::vector<std::string>& cmd, size_t from, size_t to) {
+    std::string result;
+    for (size_t i = from; i < to; ++i) {
+        if (!result.empty()) result += ' ';
+        result += cmd[i];
+    }
+    return result;
+}
+
+static bool parse_positive(const std::string& text, double& value) {
+    try {
+        size_t consumed = 0;
+        value = std::stod(text, &consumed);
+        // inf 与 nan 无法换算为定时器的时间
+        return consumed == text.size() && std::isfinite(value) && value > 0;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+#ifdef __linux__
+
+static constexpr uint32_t CHANGE_MASK = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                        IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+
+// 关闭 epoll 循环用到的所有 fd
+struct WatchFds {
+    int epoll_fd = -1;
+    int timer_fd = -1;
+    int inotify_fd = -1;
+
+    ~WatchFds() {
+        if (epoll_fd >= 0) close(epoll_fd);
+        if (timer_fd >= 0) close(timer_fd);
+        if (inotify_fd >= 0) close(inotify_fd);
+    }
+};
+
+static bool add_to_epoll(int epoll_fd, int fd) {
+    struct epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+static void arm_timer(int timer_fd, double first_secs, double interval_secs) {
+    auto to_timespec = [](double secs) {
+        struct timespec ts{};
+        ts.tv_sec = static_cast<time_t>(secs);
+        ts.tv_nsec = static_cast<long>((secs - static_cast<double>(ts.tv_sec)) * 1e9);
+        // 不足 1 ns 的正数会截断为 0，而全 0 表示关闭定时器
+        if (secs > 0 && ts.tv_sec == 0 && ts.tv_nsec == 0) ts.tv_nsec = 1;
+        return ts;
+    };
+    struct itimerspec spec{};
+    spec.it_value = to_timespec(first_secs);
+    spec.it_interval = to_timespec(interval_secs);
+    timerfd_settime(timer_fd, 0, &spec, nullptr);
+}
+
+static void drain_fd(int fd) {
+    char buffer[4096];
+    while (::read(fd, buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+/**
+ * @brief inotify 监视集合
+ *
+ * 目录递归监视，任何事件都算变化；文件则监视其父目录并按文件名过滤，
+ * 这样编辑器通过 rename 替换文件时也不会丢失监视。
+ */
+struct WatchSet {
+    struct Target {
+        std::string path;
+        bool any_name = false;
+        std::unordered_set<std::string> names;
+    };
+
+    int inotify_fd = -1;
+    std::unordered_map<int, Target> targets;
+    std::vector<std::string> roots; // 命令行给出的路径
+
+    bool add_root(const std::string& path) {
+        roots.push_back(path);
+        return add_path(path);
+    }
+
+    bool add_path(const std::string& path) {
+        return is_directory_exists(path) ? add_directory(path, true) : add_file(path);
+    }
+
+    bool add_directory(const std::string& path, bool recursive) {
+        int wd = inotify_add_watch(inotify_fd, path.c_str(), CHANGE_MASK | IN_ONLYDIR);
+        if (wd < 0) return false;
+        Target& target = targets[wd];
+        target.path = path;
+        target.any_name = true;
+
+        if (recursive) {
+            std::vector<DirEntryInfo> entries;
+            if (read_directory(path, false, entries)) {
+                for (const auto& entry : entries) {
+                    if (entry.type == EntryType::Directory) add_directory(path_join(path, entry.name), true);
+                }
+            }
+        }
+        return true;
+    }
+
+    bool add_file(const std::string& path) {
+        std::string parent = path_dirname(path);
+        int wd = inotify_add_watch(inotify_fd, parent.c_str(), CHANGE_MASK | IN_ONLYDIR);
+        if (wd < 0) return false;
+        Target& target = targets[wd];
+        target.path = parent;
+        target.names.insert(path_basename(path));
+        return true;
+    }
+
+    // 读取所有排队事件，返回其中与监视目标相关的数量
+    size_t read_changes() {
+        alignas(struct inotify_event) char buffer[16 * 1024];
+        size_t changes = 0;
+        bool overflowed = false;
+        for (;;) {
+            ssize_t n = ::read(inotify_fd, buffer, sizeof(buffer));
+            if (n <= 0) break;
+            for (ssize_t offset = 0; offset < n;) {
+                auto* event = reinterpret_cast<struct inotify_event*>(buffer + offset);
+                offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+
+                // 队列溢出（wd 为 -1）时事件已经丢失，其中可能有新建的子目录：算作一次变化，之后重新添加全部监视
+                if (event->mask & IN_Q_OVERFLOW) {
+                    overflowed = true;
+                    changes++;
+                    continue;
+                }
+
+                auto it = targets.find(event->wd);
+                if (it == targets.end()) continue;
+                if (event->mask & IN_IGNORED) {
+                    targets.erase(it);
+                    continue;
+                }
+
+                std::string name = event->len > 0 ? std::string(event->name) : "";
+                if (!it->second.any_name && it->second.names.count(name) == 0) continue;
+                changes++;
+
+                // 新建的子目录也需要加入监视
+                if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && (event->mask & IN_ISDIR) && it->second.any_name) {
+                    add_directory(path_join(it->second.path, name), true);
+                }
+            }
+        }
+        // 对已监视的目录重复添加只会返回原来的 wd
+        if (overflowed) {
+            for (const auto& root : roots) add_path(root);
+        }
+        return changes;
+    }
+};
+
+static int watch_interval(const std::string& command, double interval) {
+    InterruptScope interrupt;
+    WatchFds fds;
+    fds.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    fds.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fds.epoll_fd < 0 || fds.timer_fd < 0 || interrupt.read_fd() < 0 ||
+        !add_to_epoll(fds.epoll_fd, fds.timer_fd) || !add_to_epoll(fds.epoll_fd, interrupt.read_fd())) {
+        println(RED << BOLD << "watch: failed to set up event loop: " << strerror(errno) << RESET);
+        return 1;
+    }
+
+    execute_command(command);
+    arm_timer(fds.timer_fd, interval, interval);
+
+    for (;;) {
+        struct epoll_event events[4];
+        int n = epoll_wait(fds.epoll_fd, events, 4, -1);
+        if (n < 0 && errno != EINTR) break;
+        if (watch_interrupted) break;
+
+        bool due = false;
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.fd == fds.timer_fd) {
+                drain_fd(fds.timer_fd);
+                due = true;
+            }
+        }
+        if (!due) continue;
+
+        println(DIM << "[watch] every " << interval << "s: " << command << RESET);
+        execute_command(command);
+        if (watch_interrupted) break;
+    }
+    println("");
+    return 0;
+}
+
+static int watch_changes(const std::vector<std::string>& paths, const std::string& command, double debounce) {
+    InterruptScope interrupt;
+    WatchFds fds;
+    fds.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    fds.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    fds.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fds.epoll_fd < 0 || fds.timer_fd < 0 || fds.inotify_fd < 0 || interrupt.read_fd() < 0 ||
+        !add_to_epoll(fds.epoll_fd, fds.timer_fd) || !add_to_epoll(fds.epoll_fd, fds.inotify_fd) ||
+        !add_to_epoll(fds.epoll_fd, interrupt.read_fd())) {
+        println(RED << BOLD << "on-change: failed to set up event loop: " << strerror(errno) << RESET);
+        return 1;
+    }
+
+    WatchSet watches;
+    watches.inotify_fd = fds.inotify_fd;
+    for (const auto& path : paths) {
+        if (!watches.add_root(path)) {
+            println(RED << BOLD << "on-change: cannot watch " << path << ": " << strerror(errno) << RESET);
+            return 1;
+        }
+    }
+
+    execute_command(command);
+    watches.read_changes(); // 忽略命令自身造成的变化
+
+    // 去抖：每次新事件都把定时器往后推，但从第一次变化起最多等待 10 个窗口
+    const auto max_wait = std::chrono::duration<double>(debounce * 10);
+    size_t pending = 0;
+    std::chrono::steady_clock::time_point first_change;
+
+    for (;;) {
+        struct epoll_event events[4];
+        int n = epoll_wait(fds.epoll_fd, events, 4, -1);
+        if (n < 0 && errno != EINTR) break;
+        if (watch_interrupted) break;
+
+        bool due = false;
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.fd == fds.inotify_fd) {
+                size_t changes = watches.read_changes();
+                if (changes == 0) continue;
+                auto now = std::chrono::steady_clock::now();
+                if (pending == 0) first_change = now;
+                pending += changes;
+
+                double remaining = (max_wait - (now - first_change)).count();
+                arm_timer(fds.timer_fd, std::max(0.001, std::min(debounce, remaining)), 0);
+            }
+            else if (events[i].data.fd == fds.timer_fd) {
+                drain_fd(fds.timer_fd);
+                due = pending > 0;
+            }
+        }
+        if (!due) continue;
+
+        println(DIM << "[on-change] " << pending << " change(s) detected, running: " << command << RESET);
+        pending = 0;
+        execute_command(command);
+        watches.read_changes();
+        if (watch_interrupted) break;
+    }
+    println("");
+    return 0;
+}
+
+#else // !__linux__
+
+// 没有 inotify/epoll 的平台：低频轮询修改时间，仍然不会占满 CPU
+
+static void sleep_interruptible(double secs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(secs);
+    while (!watch_interrupted && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+static int watch_interval(const std::string& command, double interval) {
+    InterruptScope interrupt;
+    execute_command(command);
+    for (;;) {
+        sleep_interruptible(interval);
+        if (watch_interrupted) break;
+        println(DIM << "[watch] every " << interval << "s: " << command << RESET);
+        execute_command(command);
+    }
+    println("");
+    return 0;
+}
+
+static std::string snapshot(const std::vector<std::string>& paths) {
+    std::string state;
+    for (const auto& path : paths) {
+        struct stat info{};
+        if (stat(path.c_str(), &info) == 0) {
+            state += std::to_string(static_cast<long long>(info.st_mtime)) + ":" +
+                     std::to_string(static_cast<long long>(info.st_size)) + ";";
+        }
+        else {
+            state += "-;";
+        }
+    }
+    return state;
+}
+
+static int watch_changes(const std::vector<std::string>& paths, const std::string& command, double debounce) {
+    InterruptScope interrupt;
+    execute_command(command);
+    std::string last = snapshot(paths);
+    for (;;) {
+        sleep_interruptible(std::max(0.5, debounce));
+        if (watch_interrupted) break;
+        std::string current = snapshot(paths);
+        if (current == last) continue;
+
+        println(DIM << "[on-change] change detected, running: " << command << RESET);
+        execute_command(command);
+        last = snapshot(paths);
+    }
+    println("");
+    return 0;
+}
+
+#endif // __linux__
+
+int builtin_watch(const std::vector<std::string>& cmd) {
+    double interval = 2.0;
+    size_t begin = 1;
+    size_t end = cmd.size();
+
+    // 支持 watch -n 5 <cmd> 与 watch <cmd> -n 5 两种写法
+    if (end - begin >= 2 && cmd[begin] == "-n") {
+        if (!parse_positive(cmd[begin + 1], interval)) begin = end;
+        else begin += 2;
+    }
+    else if (end - begin >= 3 && cmd[end - 2] == "-n" && parse_positive(cmd[end - 1], interval)) {
+        end -= 2;
+    }
+
+    if (begin >= end) {
+        println("Usage: watch [-n secs] <command>\n"
+                "Runs <command> every <secs> seconds (default 2) until Ctrl+C.");
+        return 1;
+    }
+    return watch_interval(join_args(cmd, begin, end), interval);
+}
+
+int builtin_on_change(const std::vector<std::string>& cmd) {
+    double debounce = 0.2;
+    std::vector<std::string> paths;
+    size_t separator = cmd.size();
+
+    for (size_t i = 1; i < cmd.size(); ++i) {
+        if (cmd[i] == "--") {
+            separator = i;
+            break;
+        }
+        if (cmd[i] == "-d" && i + 1 < cmd.size()) {
+            double ms = 0;
+            if (!parse_positive(cmd[++i], ms)) {
+                println(RED << BOLD << "Invalid debounce: " << cmd[i] << RESET);
+                return 1;
+            }
+            debounce = ms / 1000.0;
+            continue;
+        }
+        paths.push_back(resolve_path(cmd[i]));
+    }
+
+    if (paths.empty() || separator + 1 >= cmd.size()) {
+        println("Usage: on-change [-d ms] <paths...> -- <command>\n"
+                "Runs <command> once, then again whenever the paths change.\n"
+                "Bursts of changes are coalesced within a debounce window (default 200 ms).");
+        return 1;
+    }
+    return watch_changes(paths, join_args(cmd, separator + 1, cmd.size()), debounce);
+}
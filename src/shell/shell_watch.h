@@ -0,0 +1,13 @@
+#ifndef SHELL_WATCH_H
+#define SHELL_WATCH_H
+
+#include <string>
+#include <vector>
+
+// watch [-n secs] <cmd>：按固定间隔重复执行命令，Ctrl+C 退出
+int builtin_watch(const std::vector<std::string>& cmd);
+
+// on-change [-d ms] <paths...> -- <cmd>：路径内容变化后重新执行命令
+int builtin_on_change(const std::vector<std::string>& cmd);
+
+#endif // SHELL_WATCH_H
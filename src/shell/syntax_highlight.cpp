@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cstddef>
+
+#include "../header.h"
+#include "shell_completion.h"
+#include "syntax_highlight.h"
+
+const std::string& highlight_sgr(HighlightStyle style) {
+    // 每个样式都先重置，避免加粗等属性带到下一段
+    static const std::string sequences[] = {
+        RESET,                // Plain
+        RESET + BOLD + GREEN, // Builtin
+        RESET + MAGENTA,      // Plugin
+        RESET + GREEN,        // External
+        RESET + RED,          // Unknown
+        RESET + YELLOW,       // String
+        RESET + CYAN,         // Variable
+        RESET + DIM,          // Suggestion
+    };
+    return sequences[static_cast<size_t>(style)];
+}
+
+static bool starts_variable(const std::string& text, size_t pos) {
+    return pos + 1 < text.size() && text[pos] == '$' && text[pos + 1] == '{';
+}
+
+static bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\n';
+}
+
+// 从 pos 开始分析一个记号，state 为开始时的引号状态，返回时更新为记号之后的状态
+SyntaxHighlighter::Token SyntaxHighlighter::lex_token(const std::string& text, size_t pos, LexState& state) {
+    Token token{pos, pos, TokenType::String, state};
+    size_t i = pos;
+
+    // ${...} 在引号内外都会被替换，到第一个 } 为止（与 VariableExpansion 一致）
+    if (starts_variable(text, i)) {
+        size_t close = text.find('}', i + 2);
+        token.type = TokenType::Variable;
+        token.end = close == std::string::npos ? text.size() : close + 1;
+        return token;
+    }
+
+    if (state == LexState::Normal) {
+        if (is_blank(text[i])) {
+            while (i < text.size() && is_blank(text[i])) i++;
+            token.type = TokenType::Space;
+            token.end = i;
+            return token;
+        }
+        if (text[i] != '"' && text[i] != '\'') {
+            while (i < text.size() && !is_blank(text[i]) && text[i] != '"' && text[i] != '\'' &&
+                   !starts_variable(text, i)) {
+                i++;
+            }
+            token.type = TokenType::Word;
+            token.end = i;
+            return token;
+        }
+        state = text[i] == '"' ? LexState::DoubleQuote : LexState::SingleQuote;
+        i++;
+    }
+
+    // 引号内：到闭合的引号、下一个 ${ 或行尾为止
+    const char quote = state == LexState::DoubleQuote ? '"' : '\'';
+    while (i < text.size()) {
+        if (text[i] == quote) {
+            i++;
+            state = LexState::Normal;
+            break;
+        }
+        if (starts_variable(text, i)) break;
+        i++;
+    }
+    token.end = i;
+    return token;
+}
+
+/**
+ * 旧文本中 [prefix, old_suffix_start) 被替换为新文本中的 [prefix, new_suffix_start)。
+ * 从修改点所在的记号开始重新分析，进入未修改的后缀后，一旦新记号的起点和引号状态与某个旧记号一致，
+ * 之后的结果必然相同，直接沿用旧记号。
+ */
+void SyntaxHighlighter::relex(size_t prefix, size_t old_suffix_start, size_t new_suffix_start) {
+    // 记号的结束位置取决于其后的一个字符（是否为 "${" 的开头），因此结束于修改点前一个字节的记号也要重新分析
+    auto first_it = std::lower_bound(tokens.begin(), tokens.end(), prefix,
+                                     [](const Token& token, size_t pos) { return token.end + 1 < pos; });
+    auto first = static_cast<size_t>(first_it - tokens.begin());
+    size_t pos = first < tokens.size() ? tokens[first].start : 0;
+    LexState state = first < tokens.size() ? tokens[first].entry : LexState::Normal;
+    const std::ptrdiff_t delta =
+        static_cast<std::ptrdiff_t>(new_suffix_start) - static_cast<std::ptrdiff_t>(old_suffix_start);
+
+    std::vector<Token> fresh;
+    size_t old_index = first;
+    while (pos < text.size()) {
+        if (pos >= new_suffix_start) {
+            size_t old_pos = static_cast<size_t>(static_cast<std::ptrdiff_t>(pos) - delta);
+            while (old_index < tokens.size() && tokens[old_index].start < old_pos) old_index++;
+            if (old_index < tokens.size() && tokens[old_index].start == old_pos && tokens[old_index].entry == state) {
+                for (size_t i = old_index; i < tokens.size(); ++i) {
+                    tokens[i].start = static_cast<size_t>(static_cast<std::ptrdiff_t>(tokens[i].start) + delta);
+                    tokens[i].end = static_cast<size_t>(static_cast<std::ptrdiff_t>(tokens[i].end) + delta);
+                }
+                tokens.erase(tokens.begin() + static_cast<std::ptrdiff_t>(first),
+                             tokens.begin() + static_cast<std::ptrdiff_t>(old_index));
+                tokens.insert(tokens.begin() + static_cast<std::ptrdiff_t>(first), fresh.begin(), fresh.end());
+                // 之后的记号都没有变，结束时的状态也和原来一样
+                return;
+            }
+        }
+        Token token = lex_token(text, pos, state);
+        fresh.push_back(token);
+        pos = token.end;
+    }
+
+    // 一直分析到行尾
+    tokens.erase(tokens.begin() + static_cast<std::ptrdiff_t>(first), tokens.end());
+    tokens.insert(tokens.end(), fresh.begin(), fresh.end());
+}
+
+HighlightStyle SyntaxHighlighter::command_style(const std::string& name) {
+    auto it = command_cache.find(name);
+    if (it != command_cache.end()) return it->second;
+
+    HighlightStyle style = HighlightStyle::Unknown;
+    switch (lookup_command(name)) {
+        case CommandKind::Builtin: style = HighlightStyle::Builtin; break;
+        case CommandKind::Plugin: style = HighlightStyle::Plugin; break;
+        case CommandKind::External: style = HighlightStyle::External; break;
+        case CommandKind::Unknown: break;
+    }
+    command_cache.emplace(name, style);
+    return style;
+}
+
+void SyntaxHighlighter::paint() {
+    styles.assign(text.size(), HighlightStyle::Plain);
+    auto fill = [this](const Token& token, HighlightStyle style) {
+        std::fill(styles.begin() + static_cast<std::ptrdiff_t>(token.start),
+                  styles.begin() + static_cast<std::ptrdiff_t>(token.end), style);
+    };
+
+    for (const Token& token : tokens) {
+        if (token.type == TokenType::String) fill(token, HighlightStyle::String);
+        else if (token.type == TokenType::Variable) fill(token, HighlightStyle::Variable);
+    }
+
+    // 第一个词只由一个普通记号组成时按命令名着色；含有变量或引号的命令名要到执行时才能确定
+    size_t i = 0;
+    while (i < tokens.size() && tokens[i].type == TokenType::Space) i++;
+    if (i < tokens.size() && tokens[i].type == TokenType::Word &&
+        (i + 1 == tokens.size() || tokens[i + 1].type == TokenType::Space)) {
+        fill(tokens[i], command_style(text.substr(tokens[i].start, tokens[i].end - tokens[i].start)));
+    }
+}
+
+void SyntaxHighlighter::reset() {
+    text.clear();
+    tokens.clear();
+    styles.clear();
+    command_cache.clear();
+    refresh_command_index();
+}
+
+const std::vector<HighlightStyle>& SyntaxHighlighter::update(const std::string& buffer) {
+    size_t limit = std::min(text.size(), buffer.size());
+    size_t prefix = 0;
+    while (prefix < limit && text[prefix] == buffer[prefix]) prefix++;
+    if (prefix == text.size() && prefix == buffer.size()) return styles;
+    size_t suffix = 0;
+    while (suffix < limit - prefix && text[text.size() - 1 - suffix] == buffer[buffer.size() - 1 - suffix]) suffix++;
+
+    size_t old_suffix_start = text.size() - suffix;
+    text = buffer;
+    relex(prefix, old_suffix_start, buffer.size() - suffix);
+    paint();
+    return styles;
+}
+
+bool SyntaxHighlighter::incomplete() const {
+    // 命令执行时按空格拆分参数，不认识引号，所以未闭合的引号不算没有输入完
+    if (tokens.empty()) return false;
+    const Token& last = tokens.back();
+    if (last.type == TokenType::Variable && text[last.end - 1] != '}') return true;
+    return text.back() == '\\';
+}
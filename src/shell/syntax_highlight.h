@@ -0,0 +1,64 @@
+#ifndef SYNTAX_HIGHLIGHT_H
+#define SYNTAX_HIGHLIGHT_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class HighlightStyle : uint8_t {
+    Plain,
+    Builtin,  // 内置命令
+    Plugin,   // 插件命令别名
+    External, // PATH 中的命令
+    Unknown,  // 找不到的命令
+    String,   // 引号括起的字符串
+    Variable, // ${var}
+    Suggestion, // 自动提示的灰色文字
+};
+
+// 样式对应的 SGR 转义序列，Plain 为重置
+const std::string& highlight_sgr(HighlightStyle style);
+
+/**
+ * @brief 输入行的语法高亮
+ *
+ * 词法分析结果按记号保存，每个记号记下开始时所处的引号状态。缓冲区变化后只从被修改的记号开始
+ * 重新分析，直到新记号的边界和状态与旧记号重新对齐，其余记号只平移位置。
+ * 命令名的类别来自补全使用的命令索引，同一行中查过的名字直接取缓存结果。
+ * 最后一个记号同时用来判断输入是否完整，决定回车是执行命令还是换行继续输入。
+ */
+class SyntaxHighlighter {
+public:
+    // 开始新的一行：清空记号与缓存，并按需更新命令索引
+    void reset();
+
+    // 更新为 buffer 的高亮，返回每个字节的样式
+    const std::vector<HighlightStyle>& update(const std::string& buffer);
+
+    // 最近一次 update 的内容是否还没有输入完整：${ 没有闭合，或以续行的反斜杠结尾
+    bool incomplete() const;
+
+private:
+    enum class LexState : uint8_t { Normal, DoubleQuote, SingleQuote };
+    enum class TokenType : uint8_t { Space, Word, String, Variable };
+
+    struct Token {
+        size_t start;
+        size_t end;
+        TokenType type;
+        LexState entry; // 记号开始处的引号状态
+    };
+
+    static Token lex_token(const std::string& text, size_t pos, LexState& state);
+    void relex(size_t prefix, size_t old_suffix_start, size_t new_suffix_start);
+    HighlightStyle command_style(const std::string& name);
+    void paint();
+
+    std::string text;
+    std::vector<Token> tokens;
+    std::vector<HighlightStyle> styles;
+    std::unordered_map<std::string, HighlightStyle> command_cache;
+};
+
+#endif // SYNTAX_HIGHLIGHT_H
@@ -0,0 +1,192 @@
+#include <csignal>
+#include <cstdlib>
+
+#include "../header.h"
+#include "terminal_session.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+termios original{};
+termios raw{};
+bool entered = false;
+volatile std::sig_atomic_t raw_active = 0;
+volatile std::sig_atomic_t size_changed = 1;
+size_t cached_columns = 80;
+// 执行命令期间由 shell 改为忽略的信号及其原来的处理，子进程中要恢复为默认处理
+bool interrupt_ignored = false;
+bool quit_ignored = false;
+struct sigaction previous_interrupt{};
+struct sigaction previous_quit{};
+
+constexpr char PASTE_ON[] = "\033[?2004h";
+constexpr char PASTE_OFF[] = "\033[?2004l";
+
+// 收到这些信号时 shell 会终止，先恢复终端
+constexpr int FATAL_SIGNALS[] = {SIGHUP, SIGTERM, SIGQUIT, SIGABRT, SIGSEGV, SIGBUS, SIGFPE, SIGILL};
+
+// 只使用异步信号安全的调用，信号处理函数中也可以使用
+void write_all(const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = ::write(STDOUT_FILENO, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+}
+
+void apply_original() {
+    tcsetattr(STDIN_FILENO, TCSANOW, &original);
+    write_all(PASTE_OFF, sizeof(PASTE_OFF) - 1);
+    raw_active = 0;
+}
+
+void apply_raw() {
+    std::cout.flush();
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    write_all(PASTE_ON, sizeof(PASTE_ON) - 1);
+    raw_active = 1;
+}
+
+void on_fatal_signal(int sig) {
+    int saved_errno = errno;
+    if (raw_active) apply_original();
+    errno = saved_errno;
+    // 处理函数已被 SA_RESETHAND 复位，再次发出的信号按默认方式终止进程
+    raise(sig);
+}
+
+void on_resize(int) {
+    size_changed = 1;
+}
+
+bool install_resize_handler() {
+    struct sigaction action{};
+    action.sa_handler = on_resize;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    return sigaction(SIGWINCH, &action, nullptr) == 0;
+}
+
+void install_fatal_handlers() {
+    for (int sig : FATAL_SIGNALS) {
+        // 不覆盖已被忽略或接管的信号（例如 nohup 下的 SIGHUP）
+        struct sigaction current{};
+        if (sigaction(sig, nullptr, &current) != 0 || current.sa_handler != SIG_DFL) continue;
+        struct sigaction action{};
+        action.sa_handler = on_fatal_signal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESETHAND;
+        sigaction(sig, &action, nullptr);
+    }
+}
+
+// 信号会终止 shell 时（默认处理或恢复终端后终止）改为忽略，原来的处理保存在 previous 中，返回是否做了修改
+bool ignore_while_foreground(int sig, struct sigaction& previous) {
+    struct sigaction current{};
+    if (sigaction(sig, nullptr, &current) != 0) return false;
+    if (current.sa_handler != SIG_DFL && current.sa_handler != on_fatal_signal) return false;
+    struct sigaction action{};
+    action.sa_handler = SIG_IGN;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(sig, &action, nullptr) != 0) return false;
+    previous = current;
+    return true;
+}
+
+} // namespace
+
+void TerminalSession::enter() {
+    if (entered) return;
+    entered = true;
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &original) != 0) return;
+
+    // 按键逐个读取且不回显，由编辑器自己输出；Ctrl+C 等也作为按键交给编辑器。
+    // 保留输出处理（OPOST），其他代码输出的 '\n' 仍然换到行首
+    raw = original;
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    raw.c_iflag &= ~(IXON | ICRNL);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+
+    install_fatal_handlers();
+    std::atexit(restore);
+    apply_raw();
+}
+
+void TerminalSession::restore() {
+    if (!raw_active) return;
+    std::cout.flush();
+    apply_original();
+}
+
+size_t TerminalSession::columns() {
+    static const bool resize_handled = install_resize_handler();
+    if (size_changed || !resize_handled) {
+        size_changed = 0;
+        struct winsize ws{};
+        cached_columns = ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 ? ws.ws_col : 80;
+    }
+    return cached_columns;
+}
+
+void TerminalSession::prepare_child() {
+    if (interrupt_ignored) signal(SIGINT, SIG_DFL);
+    if (quit_ignored) signal(SIGQUIT, SIG_DFL);
+}
+
+TerminalSession::Foreground::Foreground() {
+    if (raw_active) {
+        restore();
+        switched = true;
+    }
+    ignored_interrupt = ignore_while_foreground(SIGINT, previous_interrupt);
+    ignored_quit = ignore_while_foreground(SIGQUIT, previous_quit);
+    if (ignored_interrupt) interrupt_ignored = true;
+    if (ignored_quit) quit_ignored = true;
+}
+
+TerminalSession::Foreground::~Foreground() {
+    if (ignored_interrupt) {
+        sigaction(SIGINT, &previous_interrupt, nullptr);
+        interrupt_ignored = false;
+    }
+    if (ignored_quit) {
+        sigaction(SIGQUIT, &previous_quit, nullptr);
+        quit_ignored = false;
+    }
+    // 前台程序可能改了终端设置而没有恢复（例如异常退出的全屏程序），重新设置一次
+    if (switched) apply_raw();
+}
+
+#else // _WIN32
+
+// _getch() 本身就逐个读取按键且不回显，控制台不需要切换模式
+
+void TerminalSession::enter() {}
+
+void TerminalSession::restore() {}
+
+size_t TerminalSession::columns() {
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+        return static_cast<size_t>(info.srWindow.Right - info.srWindow.Left + 1);
+    }
+    return 80;
+}
+
+void TerminalSession::prepare_child() {}
+
+TerminalSession::Foreground::Foreground() {}
+
+TerminalSession::Foreground::~Foreground() {}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef TERMINAL_SESSION_H
+#define TERMINAL_SESSION_H
+
+#include <cstddef>
+
+/**
+ * @brief 交互式会话的终端状态
+ *
+ * 第一次读取输入时保存终端原来的设置并切换到 raw 模式，之后整个会话保持不变，
+ * 只在执行命令期间临时切回原来的模式，把终端交给前台程序。正常退出和收到致命信号时恢复原来的设置。
+ * 终端宽度在收到 SIGWINCH 之后才重新查询，重绘时直接使用缓存的值。
+ */
+class TerminalSession {
+public:
+    // 切换到 raw 模式，只有第一次调用生效；stdin 不是终端时什么也不做
+    static void enter();
+
+    // 恢复进入 raw 模式前的终端设置
+    static void restore();
+
+    // 终端的列数
+    static size_t columns();
+
+    // fork 之后、exec 之前在子进程中调用：恢复 shell 为等待前台程序而忽略的信号
+    static void prepare_child();
+
+    /**
+     * @brief 执行命令期间的作用域
+     *
+     * 构造时切回原来的终端模式并关闭括号粘贴，shell 忽略 SIGINT / SIGQUIT，
+     * Ctrl+C 只终止前台程序；析构时重新进入 raw 模式。
+     */
+    class Foreground {
+    public:
+        Foreground();
+        ~Foreground();
+
+        Foreground(const Foreground&) = delete;
+        Foreground& operator=(const Foreground&) = delete;
+
+    private:
+        bool switched = false;
+        bool ignored_interrupt = false;
+        bool ignored_quit = false;
+    };
+};
+
+#endif // TERMINAL_SESSION_H
@@ -0,0 +1,148 @@
+#include <algorithm>
+
+#include "trigram_index.h"
+
+void TrigramIndex::clear() {
+    lists.clear();
+    slot_keys.clear();
+    slot_lists.clear();
+    slot_bits = 0;
+}
+
+// key 所在的槽位，或者它应当插入的空槽位（线性探测）
+size_t TrigramIndex::slot_of(uint32_t key) const {
+    size_t mask = slot_keys.size() - 1;
+    size_t slot = (key * 2654435761u) >> (32 - slot_bits);
+    while (slot_keys[slot] != EMPTY_SLOT && slot_keys[slot] != key) slot = (slot + 1) & mask;
+    return slot;
+}
+
+void TrigramIndex::grow() {
+    slot_bits = slot_bits == 0 ? 10 : slot_bits + 1;
+    slot_keys.assign(size_t(1) << slot_bits, EMPTY_SLOT);
+    slot_lists.assign(size_t(1) << slot_bits, 0);
+    for (uint32_t i = 0; i < lists.size(); ++i) {
+        size_t slot = slot_of(lists[i].key);
+        slot_keys[slot] = lists[i].key;
+        slot_lists[slot] = i;
+    }
+}
+
+const TrigramIndex::PostingList* TrigramIndex::find_list(uint32_t key) const {
+    if (slot_keys.empty()) return nullptr;
+    size_t slot = slot_of(key);
+    return slot_keys[slot] == EMPTY_SLOT ? nullptr : &lists[slot_lists[slot]];
+}
+
+TrigramIndex::PostingList& TrigramIndex::list_for(uint32_t key) {
+    // 负载超过一半时扩容
+    if ((lists.size() + 1) * 2 > slot_keys.size()) grow();
+    size_t slot = slot_of(key);
+    if (slot_keys[slot] == EMPTY_SLOT) {
+        slot_keys[slot] = key;
+        slot_lists[slot] = static_cast<uint32_t>(lists.size());
+        lists.emplace_back();
+        lists.back().key = key;
+    }
+    return lists[slot_lists[slot]];
+}
+
+static uint32_t ascii_lower(char c) {
+    auto byte = static_cast<unsigned char>(c);
+    return byte >= 'A' && byte <= 'Z' ? byte + ('a' - 'A') : byte;
+}
+
+// 依次对文本中的每个三元组（可能重复）调用 visit
+template <typename Visit>
+static void for_each_trigram(std::string_view text, Visit visit) {
+    if (text.size() < 3) return;
+    uint32_t key = (ascii_lower(text[0]) << 8) | ascii_lower(text[1]);
+    for (size_t i = 2; i < text.size(); ++i) {
+        key = ((key << 8) | ascii_lower(text[i])) & 0xFFFFFF;
+        visit(key);
+    }
+}
+
+void TrigramIndex::PostingList::push(uint32_t id) {
+    if (count % BLOCK_SIZE == 0) {
+        blocks.push_back(Block{id, static_cast<uint32_t>(bytes.size())});
+    }
+    else {
+        for (uint32_t delta = id - last;; delta >>= 7) {
+            if (delta < 0x80) {
+                bytes.push_back(static_cast<uint8_t>(delta));
+                break;
+            }
+            bytes.push_back(static_cast<uint8_t>((delta & 0x7F) | 0x80));
+        }
+    }
+    last = id;
+    count++;
+}
+
+bool TrigramIndex::PostingList::seek_le(uint32_t target, uint32_t& id) const {
+    if (count == 0 || blocks.front().first > target) return false;
+    if (last <= target) {
+        id = last;
+        return true;
+    }
+
+    // 最后一个起始编号不大于 target 的块，在块内顺序解码
+    auto block = std::upper_bound(blocks.begin(), blocks.end(), target,
+                                  [](uint32_t value, const Block& b) { return value < b.first; }) - 1;
+    size_t end = block + 1 == blocks.end() ? bytes.size() : (block + 1)->offset;
+    uint32_t current = block->first;
+    for (size_t pos = block->offset; pos < end;) {
+        uint32_t delta = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = bytes[pos++];
+            delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        if (current + delta > target) break;
+        current += delta;
+    }
+    id = current;
+    return true;
+}
+
+void TrigramIndex::add(uint32_t id, std::string_view text) {
+    for_each_trigram(text, [&](uint32_t key) {
+        PostingList& list = list_for(key);
+        // 同一文档中重复出现的三元组只记一次
+        if (list.count == 0 || list.last != id) list.push(id);
+    });
+}
+
+uint32_t TrigramIndex::find_before(const std::string& query, uint32_t before) const {
+    std::vector<uint32_t> keys;
+    for_each_trigram(query, [&](uint32_t key) { keys.push_back(key); });
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    if (keys.empty() || before == 0) return NPOS;
+
+    std::vector<const PostingList*> postings;
+    for (uint32_t key : keys) {
+        const PostingList* list = find_list(key);
+        if (!list) return NPOS;
+        postings.push_back(list);
+    }
+    std::sort(postings.begin(), postings.end(),
+              [](const PostingList* a, const PostingList* b) { return a->count < b->count; });
+
+    // 从最短的倒排表开始，每张表跳到不大于 target 的最近一项；有一张表落后就以它为新的 target 重新开始
+    uint32_t target = before - 1;
+    for (;;) {
+        bool agreed = true;
+        for (const PostingList* list : postings) {
+            uint32_t id;
+            if (!list->seek_le(target, id)) return NPOS;
+            if (id < target) {
+                target = id;
+                agreed = false;
+                break;
+            }
+        }
+        if (agreed) return target;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief 三元组（trigram）倒排索引
+ *
+ * 每个文档按 ASCII 小写后的连续 3 字节建立倒排表。倒排表中的文档编号递增，
+ * 以 LEB128 编码相邻编号之差，每 64 条保存一个检查点，查找不大于某编号的最近一项
+ * 只需二分检查点并解码一个块。查询时从最短的倒排表开始交替跳跃求交集，
+ * 返回的只是候选，调用方仍需确认文本确实包含查询串。
+ * 三元组到倒排表的映射是开放寻址的哈希表，建索引时每个三元组只需一次乘法和几次比较。
+ */
+class TrigramIndex {
+public:
+    static constexpr uint32_t NPOS = UINT32_MAX;
+
+    void clear();
+
+    // 添加一个文档，编号必须大于之前添加的所有文档
+    void add(uint32_t id, std::string_view text);
+
+    // 查询串是否足够长，能用索引查找（短于 3 字节时调用方需要顺序扫描）
+    static bool usable(const std::string& query) { return query.size() >= 3; }
+
+    // 编号小于 before 的文档中，包含 query 全部三元组的最大编号，没有时返回 NPOS
+    uint32_t find_before(const std::string& query, uint32_t before) const;
+
+private:
+    static constexpr uint32_t BLOCK_SIZE = 64;
+
+    struct Block {
+        uint32_t first;  // 块内第一个编号
+        uint32_t offset; // 块内其余编号的差值在 bytes 中的起点
+    };
+
+    struct PostingList {
+        uint32_t key = 0;
+        std::vector<uint8_t> bytes;
+        std::vector<Block> blocks;
+        uint32_t count = 0;
+        uint32_t last = 0;
+
+        void push(uint32_t id);
+        bool seek_le(uint32_t target, uint32_t& id) const;
+    };
+
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    const PostingList* find_list(uint32_t key) const;
+    PostingList& list_for(uint32_t key);
+    size_t slot_of(uint32_t key) const;
+    void grow();
+
+    std::vector<PostingList> lists;
+    std::vector<uint32_t> slot_keys;  // 哈希表：三元组，EMPTY_SLOT 表示空位
+    std::vector<uint32_t> slot_lists; // 哈希表：对应的 lists 下标
+    uint32_t slot_bits = 0;
+};
+
+#endif // TRIGRAM_INDEX_H
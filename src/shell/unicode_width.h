@@ -0,0 +1,34 @@
+#ifndef UNICODE_WIDTH_H
+#define UNICODE_WIDTH_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief UTF-8 解码、终端显示宽度与字素簇边界
+ *
+ * 显示宽度按 Unicode 东亚宽度（East Asian Width）计算：中日韩文字与全角字符占两列，
+ * 组合附加符号、零宽连接符、变体选择符等不占列。宽度表在编译期生成，单次查询为常数时间。
+ */
+
+// 解码 text[pos] 开始的一个码点，返回其字节长度；非法序列按 1 字节的 U+FFFD 处理
+size_t decode_utf8(const std::string& text, size_t pos, char32_t& codepoint);
+
+// 码点占用的终端列数：0、1 或 2
+int codepoint_width(char32_t codepoint);
+
+// text 中 [begin, end) 的显示列数
+size_t text_width(const std::string& text, size_t begin, size_t end);
+
+inline size_t text_width(const std::string& text) {
+    return text_width(text, 0, text.size());
+}
+
+// pos 之后（之前）最近的字素簇边界：基字符连同其后的组合字符、ZWJ 序列、肤色修饰符和国旗对视为一个整体
+size_t next_grapheme(const std::string& text, size_t pos);
+size_t prev_grapheme(const std::string& text, size_t pos);
+
+// pos 是否可以确定为字素簇边界（无法确定的国旗序列中间按 false 处理）
+bool is_grapheme_boundary(const std::string& text, size_t pos);
+
+#endif // UNICODE_WIDTH_H
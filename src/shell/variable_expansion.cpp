@@ -0,0 +1,389 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <regex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../header.h"
+#include "variable_expansion.h"
+#include "variable_store.h"
+
+namespace {
+
+enum class Method : uint8_t { Replace, Upper, Lower, Trim, Substr, Split, Len, Match };
+
+struct MethodInfo {
+    const char* name;
+    Method method;
+    size_t min_args;
+    size_t max_args;
+};
+
+constexpr MethodInfo METHODS[] = {
+    {"replace", Method::Replace, 2, 2},
+    {"upper", Method::Upper, 0, 0},
+    {"lower", Method::Lower, 0, 0},
+    {"trim", Method::Trim, 0, 0},
+    {"substr", Method::Substr, 1, 2},
+    {"split", Method::Split, 1, 2},
+    {"len", Method::Len, 0, 0},
+    {"match", Method::Match, 1, 1},
+};
+
+struct Step {
+    Method method;
+    std::string from;        // replace 的 old，split 的分隔符（空为按空白切分）
+    std::string to;          // replace 的 new
+    int64_t start = 0;       // substr 的起点，split 的下标
+    int64_t length = -1;     // substr 的长度，-1 为到末尾
+    std::regex pattern;
+};
+
+struct Pipeline {
+    VariableStore::Symbol symbol = 0;
+    bool has_key = false;
+    std::string key; // [ ] 中的下标或键
+    std::vector<Step> steps;
+};
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && is_space(text.front())) text.remove_prefix(1);
+    while (!text.empty() && is_space(text.back())) text.remove_suffix(1);
+    return text;
+}
+
+bool is_continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+size_t count_chars(std::string_view text) {
+    size_t count = 0;
+    for (char c : text) {
+        if (!is_continuation(c)) count++;
+    }
+    return count;
+}
+
+// 第 n 个 UTF-8 字符的字节位置，超出时为 text.size()
+size_t char_offset(std::string_view text, size_t n) {
+    size_t pos = 0;
+    for (; pos < text.size(); ++pos) {
+        if (!is_continuation(text[pos]) && n-- == 0) return pos;
+    }
+    return pos;
+}
+
+bool parse_integer(std::string_view text, int64_t& number) {
+    text = trim(text);
+    auto result = std::from_chars(text.data(), text.data() + text.size(), number);
+    return !text.empty() && result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+/**
+ * 解析一个表达式。args 按逗号切分，引号内的逗号不算；
+ * 用引号括起的参数原样保留，否则去掉首尾空白
+ */
+class Parser {
+public:
+    explicit Parser(std::string_view source) : source(source) {}
+
+    bool parse(Pipeline& pipeline, std::string& error) {
+        size_t name_end = 0;
+        while (name_end < source.size() && source[name_end] != '[' && source[name_end] != '.') name_end++;
+        std::string_view name = trim(source.substr(0, name_end));
+        if (name.empty()) return fail(error, "missing variable name");
+        pipeline.symbol = VariableStore::intern(name);
+        pos = name_end;
+
+        if (pos < source.size() && source[pos] == '[') {
+            size_t close = source.find(']', pos);
+            if (close == std::string_view::npos) return fail(error, "missing ']'");
+            pipeline.has_key = true;
+            pipeline.key = std::string(unquote(source.substr(pos + 1, close - pos - 1)));
+            pos = close + 1;
+        }
+
+        while (pos < source.size()) {
+            if (source[pos] != '.') return fail(error, "expected '.' before a method");
+            pos++;
+            Step step{};
+            if (!parse_step(step, error)) return false;
+            pipeline.steps.push_back(std::move(step));
+        }
+        return true;
+    }
+
+private:
+    static bool fail(std::string& error, const std::string& message) {
+        error = message;
+        return false;
+    }
+
+    static std::string_view unquote(std::string_view arg) {
+        arg = trim(arg);
+        if (arg.size() >= 2 && (arg.front() == '"' || arg.front() == '\'') && arg.back() == arg.front()) {
+            return arg.substr(1, arg.size() - 2);
+        }
+        return arg;
+    }
+
+    bool parse_args(std::vector<std::string_view>& args, std::string& error) {
+        // pos 位于 '(' 之后
+        size_t start = pos;
+        char quote = 0;
+        for (; pos < source.size(); ++pos) {
+            char c = source[pos];
+            if (quote) {
+                if (c == quote) quote = 0;
+            }
+            else if (c == '"' || c == '\'') {
+                quote = c;
+            }
+            else if (c == ',' || c == ')') {
+                std::string_view arg = source.substr(start, pos - start);
+                // 空括号表示没有参数
+                if (c == ',' || !args.empty() || !trim(arg).empty()) args.push_back(unquote(arg));
+                start = pos + 1;
+                if (c == ')') {
+                    pos++;
+                    return true;
+                }
+            }
+        }
+        return fail(error, quote ? "unterminated quote" : "missing ')'");
+    }
+
+    bool parse_step(Step& step, std::string& error) {
+        size_t name_start = pos;
+        while (pos < source.size() && (std::isalpha(static_cast<unsigned char>(source[pos])) || source[pos] == '_')) pos++;
+        std::string_view name = source.substr(name_start, pos - name_start);
+        const MethodInfo* info = nullptr;
+        for (const MethodInfo& candidate : METHODS) {
+            if (name == candidate.name) info = &candidate;
+        }
+        if (!info) return fail(error, "unknown method '" + std::string(name) + "'");
+
+        std::vector<std::string_view> args;
+        if (pos < source.size() && source[pos] == '(') {
+            pos++;
+            if (!parse_args(args, error)) return false;
+        }
+        if (args.size() < info->min_args || args.size() > info->max_args) {
+            return fail(error, "wrong number of arguments to " + std::string(name));
+        }
+
+        step.method = info->method;
+        switch (step.method) {
+        case Method::Replace:
+            step.from = std::string(args[0]);
+            step.to = std::string(args[1]);
+            break;
+        case Method::Substr:
+            if (!parse_integer(args[0], step.start) || (args.size() > 1 && !parse_integer(args[1], step.length))) {
+                return fail(error, "substr needs integer arguments");
+            }
+            if (step.length < -1) step.length = 0;
+            break;
+        case Method::Split:
+            if (args.size() > 1) step.from = std::string(args[0]);
+            if (!parse_integer(args.back(), step.start)) return fail(error, "split needs an integer index");
+            break;
+        case Method::Match:
+            try {
+                step.pattern = std::regex(std::string(args[0]));
+            }
+            catch (const std::regex_error& e) {
+                return fail(error, "invalid regex: " + std::string(e.what()));
+            }
+            break;
+        default:
+            break;
+        }
+        return true;
+    }
+
+    std::string_view source;
+    size_t pos = 0;
+};
+
+// split 的第 index 个字段，sep 为空时按连续空白切分并忽略首尾空白
+std::string_view split_field(std::string_view text, const std::string& sep, int64_t index) {
+    auto visit = [&](auto&& on_field) {
+        if (sep.empty()) {
+            size_t pos = 0;
+            for (;;) {
+                while (pos < text.size() && is_space(text[pos])) pos++;
+                if (pos >= text.size()) return;
+                size_t end = pos;
+                while (end < text.size() && !is_space(text[end])) end++;
+                if (!on_field(text.substr(pos, end - pos))) return;
+                pos = end;
+            }
+        }
+        size_t pos = 0;
+        for (;;) {
+            size_t end = text.find(sep, pos);
+            if (!on_field(text.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos))) return;
+            if (end == std::string_view::npos) return;
+            pos = end + sep.size();
+        }
+    };
+
+    std::string_view result;
+    if (index >= 0) {
+        visit([&](std::string_view field) {
+            if (index-- > 0) return true;
+            result = field;
+            return false;
+        });
+        return result;
+    }
+    size_t count = 0;
+    visit([&](std::string_view) { count++; return true; });
+    auto target = static_cast<int64_t>(count) + index;
+    if (target < 0) return result;
+    visit([&](std::string_view field) {
+        if (target-- > 0) return true;
+        result = field;
+        return false;
+    });
+    return result;
+}
+
+void run(const Pipeline& pipeline, std::string& out) {
+    // 轮流写入的暂存缓冲区：一步从其中一个读、向另一个写，容量在多次展开之间保留
+    static std::string scratch[2];
+    size_t next = 0;
+    auto buffer = [&]() -> std::string& {
+        std::string& target = scratch[next];
+        next ^= 1;
+        target.clear();
+        return target;
+    };
+
+    std::string_view text;
+    if (const Value* value = VariableStore::get(pipeline.symbol)) {
+        if (pipeline.has_key) {
+            if (const std::string* item = value->element(pipeline.key)) text = *item;
+        }
+        else if (const std::string* string = value->string()) {
+            text = *string;
+        }
+        else {
+            std::string& rendered = buffer();
+            value->append_to(rendered);
+            text = rendered;
+        }
+    }
+
+    for (const Step& step : pipeline.steps) {
+        switch (step.method) {
+        case Method::Trim:
+            text = trim(text);
+            break;
+        case Method::Substr: {
+            auto total = static_cast<int64_t>(count_chars(text));
+            int64_t start = step.start < 0 ? std::max<int64_t>(0, total + step.start) : std::min(step.start, total);
+            size_t begin = char_offset(text, static_cast<size_t>(start));
+            size_t end = step.length < 0 ? text.size()
+                                         : begin + char_offset(text.substr(begin), static_cast<size_t>(step.length));
+            text = text.substr(begin, end - begin);
+            break;
+        }
+        case Method::Split:
+            text = split_field(text, step.from, step.start);
+            break;
+        case Method::Match: {
+            std::cmatch match;
+            if (std::regex_search(text.data(), text.data() + text.size(), match, step.pattern)) {
+                text = text.substr(static_cast<size_t>(match.position(0)), static_cast<size_t>(match.length(0)));
+            }
+            else {
+                text = std::string_view();
+            }
+            break;
+        }
+        case Method::Replace: {
+            if (step.from.empty()) break;
+            std::string& target = buffer();
+            size_t pos = 0;
+            for (size_t found; (found = text.find(step.from, pos)) != std::string_view::npos; pos = found + step.from.size()) {
+                target.append(text, pos, found - pos);
+                target += step.to;
+            }
+            target.append(text, pos, std::string_view::npos);
+            text = target;
+            break;
+        }
+        case Method::Upper:
+        case Method::Lower: {
+            std::string& target = buffer();
+            target.assign(text);
+            for (char& c : target) {
+                c = static_cast<char>(step.method == Method::Upper ? std::toupper(static_cast<unsigned char>(c))
+                                                                   : std::tolower(static_cast<unsigned char>(c)));
+            }
+            text = target;
+            break;
+        }
+        case Method::Len: {
+            std::string& target = buffer();
+            target = std::to_string(count_chars(text));
+            text = target;
+            break;
+        }
+        }
+    }
+    out.append(text);
+}
+
+// 按源文本缓存解析结果，超出上限时整体清空
+constexpr size_t MAX_CACHED_PIPELINES = 1024;
+
+std::unordered_map<std::string, Pipeline>& pipeline_cache() {
+    static std::unordered_map<std::string, Pipeline> cache;
+    return cache;
+}
+
+} // namespace
+
+bool VariableExpansion::expand(std::string& text) {
+    size_t start = text.find("${");
+    if (start == std::string::npos) return true;
+
+    auto& cache = pipeline_cache();
+    std::string out;
+    std::string expression;
+    size_t copied = 0;
+    while (start != std::string::npos) {
+        size_t close = text.find('}', start + 2);
+        if (close == std::string::npos) break; // 没有闭合的 ${ 原样保留
+        expression.assign(text, start + 2, close - start - 2);
+
+        auto it = cache.find(expression);
+        if (it == cache.end()) {
+            Pipeline pipeline;
+            std::string error;
+            if (!Parser(expression).parse(pipeline, error)) {
+                println(RED << BOLD << "Bad substitution ${" << expression << "}: " << error << RESET);
+                return false;
+            }
+            if (cache.size() >= MAX_CACHED_PIPELINES) cache.clear();
+            it = cache.emplace(expression, std::move(pipeline)).first;
+        }
+
+        out.append(text, copied, start - copied);
+        run(it->second, out);
+        copied = close + 1;
+        start = text.find("${", copied);
+    }
+    out.append(text, copied, std::string::npos);
+    text.swap(out);
+    return true;
+}
@@ -0,0 +1,26 @@
+#ifndef VARIABLE_EXPANSION_H
+#define VARIABLE_EXPANSION_H
+
+#include <string>
+
+/**
+ * @brief 变量展开 ${...}
+ *
+ * 表达式为变量名，可选的 [下标或键]，以及任意个链式调用的字符串方法，到第一个 } 为止：
+ *   ${name}  ${list[0]}  ${map[key]}  ${path.replace("/", "-").upper}  ${line.split(",", 2).trim.len}
+ *
+ * 方法：replace(old, new)、upper、lower（只转换 ASCII 字母）、trim、substr(start[, length])、
+ * split(index) 或 split(sep, index)、len、match(regex)。substr 与 len 按 UTF-8 字符计数，
+ * 负的 start / index 从末尾算起；参数可以用单引号或双引号括起。
+ *
+ * 每个表达式第一次出现时解析为一组步骤并按源文本缓存，变量名解析为 VariableStore 的符号、正则表达式预先编译。
+ * 步骤作用在 std::string_view 上：trim、substr、split、match 只缩小视图；replace、upper、lower、len
+ * 写入两个轮流使用的暂存缓冲区，缓冲区的容量在多次展开之间保留。只有最终结果复制到输出中。
+ */
+class VariableExpansion {
+public:
+    // 展开 text 中的每个 ${...}；表达式有误时输出错误信息并返回 false
+    static bool expand(std::string& text);
+};
+
+#endif // VARIABLE_EXPANSION_H
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <unordered_map>
+
+#include "../header.h"
+#include "variable_store.h"
+
+namespace {
+
+// text 整体是否为十进制整数（可带负号）
+bool parse_integer(std::string_view text, int64_t& number) {
+    if (text.empty()) return false;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), number);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+// 按 separator 切分 text，对每一段调用 visit
+template <typename Visit>
+void for_each_item(std::string_view text, char separator, Visit visit) {
+    if (text.empty()) return;
+    for (;;) {
+        size_t pos = text.find(separator);
+        visit(text.substr(0, pos));
+        if (pos == std::string_view::npos) return;
+        text.remove_prefix(pos + 1);
+    }
+}
+
+struct Slot {
+    Value value;
+    bool set = false;
+};
+
+struct StoreState {
+    std::deque<std::string> names; // 驻留的名字，deque 追加时已有元素的地址不变，可以被 string_view 引用
+    std::unordered_map<std::string_view, VariableStore::Symbol> symbols;
+    std::vector<Slot> slots;
+};
+
+StoreState& store_state() {
+    static StoreState state;
+    return state;
+}
+
+} // namespace
+
+Value Value::parse(std::string_view text) {
+    if (text.size() >= 2 && text.front() == '[' && text.back() == ']') {
+        List list;
+        for_each_item(text.substr(1, text.size() - 2), ',', [&list](std::string_view item) {
+            list.emplace_back(item);
+        });
+        return Value(std::move(list));
+    }
+    if (text.size() >= 2 && text.front() == '{' && text.back() == '}') {
+        // 缺少冒号或键重复时展开后无法还原原来的写法，作为字符串保存
+        Map map;
+        bool is_map = true;
+        for_each_item(text.substr(1, text.size() - 2), ',', [&map, &is_map](std::string_view item) {
+            size_t colon = item.find(':');
+            std::string_view key = item.substr(0, colon);
+            bool duplicate = std::any_of(map.begin(), map.end(), [key](const auto& entry) { return entry.first == key; });
+            if (colon == std::string_view::npos || duplicate) is_map = false;
+            else map.emplace_back(key, item.substr(colon + 1));
+        });
+        if (is_map) return Value(std::move(map));
+    }
+    // 只接受规范写法，"007"、"+1" 之类仍保存为字符串，展开时保持原样
+    int64_t number = 0;
+    bool canonical = !text.empty() && text.front() != '+' &&
+                     !(text.size() > 1 && text[text.front() == '-'] == '0');
+    if (canonical && parse_integer(text, number)) return Value(number);
+    return Value(std::string(text));
+}
+
+bool Value::as_integer(int64_t& number) const {
+    if (const int64_t* integer = std::get_if<int64_t>(&data)) {
+        number = *integer;
+        return true;
+    }
+    const std::string* text = std::get_if<std::string>(&data);
+    return text && parse_integer(*text, number);
+}
+
+const std::string* Value::element(std::string_view key) const {
+    if (const List* list = std::get_if<List>(&data)) {
+        size_t index = 0;
+        auto result = std::from_chars(key.data(), key.data() + key.size(), index);
+        if (result.ec != std::errc() || result.ptr != key.data() + key.size() || index >= list->size()) return nullptr;
+        return &(*list)[index];
+    }
+    if (const Map* map = std::get_if<Map>(&data)) {
+        // 映射通常只有几项，顺序查找即可
+        auto it = std::find_if(map->begin(), map->end(), [key](const auto& entry) { return entry.first == key; });
+        return it == map->end() ? nullptr : &it->second;
+    }
+    return nullptr;
+}
+
+void Value::append_to(std::string& out) const {
+    switch (type()) {
+    case Type::String:
+        out += std::get<std::string>(data);
+        break;
+    case Type::Integer: {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), std::get<int64_t>(data));
+        out.append(digits, result.ptr);
+        break;
+    }
+    case Type::List: {
+        const List& list = std::get<List>(data);
+        out += '[';
+        for (size_t i = 0; i < list.size(); ++i) {
+            if (i > 0) out += ',';
+            out += list[i];
+        }
+        out += ']';
+        break;
+    }
+    case Type::Map: {
+        const Map& map = std::get<Map>(data);
+        out += '{';
+        for (size_t i = 0; i < map.size(); ++i) {
+            if (i > 0) out += ',';
+            out += map[i].first;
+            out += ':';
+            out += map[i].second;
+        }
+        out += '}';
+        break;
+    }
+    }
+}
+
+std::string Value::to_string() const {
+    if (const std::string* text = string()) return *text;
+    std::string out;
+    append_to(out);
+    return out;
+}
+
+VariableStore::Symbol VariableStore::intern(std::string_view name) {
+    StoreState& state = store_state();
+    auto it = state.symbols.find(name);
+    if (it != state.symbols.end()) return it->second;
+    auto symbol = static_cast<Symbol>(state.names.size());
+    state.names.emplace_back(name);
+    state.symbols.emplace(state.names.back(), symbol);
+    state.slots.emplace_back();
+    return symbol;
+}
+
+const std::string& VariableStore::name(Symbol symbol) {
+    return store_state().names[symbol];
+}
+
+const Value* VariableStore::get(Symbol symbol) {
+    const Slot& slot = store_state().slots[symbol];
+    return slot.set ? &slot.value : nullptr;
+}
+
+const Value* VariableStore::get(std::string_view name) {
+    StoreState& state = store_state();
+    auto it = state.symbols.find(name);
+    return it == state.symbols.end() ? nullptr : get(it->second);
+}
+
+void VariableStore::set(Symbol symbol, Value value) {
+    StoreState& state = store_state();
+    Slot& slot = state.slots[symbol];
+    slot.value = std::move(value);
+    slot.set = true;
+    // 复用视图中原有字符串的空间
+    std::string& text = shell_global_vars[state.names[symbol]];
+    text.clear();
+    slot.value.append_to(text);
+}
+
+void VariableStore::set(std::string_view name, Value value) {
+    set(intern(name), std::move(value));
+}
+
+void VariableStore::unset(Symbol symbol) {
+    StoreState& state = store_state();
+    Slot& slot = state.slots[symbol];
+    if (!slot.set) return;
+    slot.value = Value();
+    slot.set = false;
+    shell_global_vars.erase(state.names[symbol]);
+}
+
+void VariableStore::sync_from_view() {
+    StoreState& state = store_state();
+    std::string text;
+    for (Symbol symbol = 0; symbol < state.slots.size(); ++symbol) {
+        Slot& slot = state.slots[symbol];
+        if (!slot.set) continue;
+        auto it = shell_global_vars.find(state.names[symbol]);
+        if (it == shell_global_vars.end()) {
+            slot.value = Value();
+            slot.set = false;
+            continue;
+        }
+        const std::string* current = slot.value.string();
+        if (!current) {
+            text.clear();
+            slot.value.append_to(text);
+            current = &text;
+        }
+        if (*current != it->second) slot.value = Value(it->second);
+    }
+    // 插件新增的变量
+    for (const auto& [key, value] : shell_global_vars) {
+        Slot& slot = state.slots[intern(key)];
+        if (slot.set) continue;
+        slot.value = Value(value);
+        slot.set = true;
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef VARIABLE_STORE_H
+#define VARIABLE_STORE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/**
+ * @brief shell 变量的值：字符串、整数、列表或映射
+ *
+ * 字符串直接保存为 std::string，短字符串存放在对象内部（SSO），不另外分配内存。
+ * 列表与映射的元素都是字符串，映射按写入的顺序保存。展开为文本时输出与 set 时相同的写法（[a,b]、{k:v}），
+ * 元素只能通过下标或键取得。
+ */
+class Value {
+public:
+    enum class Type : uint8_t { String, Integer, List, Map };
+    using List = std::vector<std::string>;
+    using Map = std::vector<std::pair<std::string, std::string>>;
+
+    Value() = default;
+    Value(std::string text) : data(std::move(text)) {}
+    explicit Value(int64_t number) : data(number) {}
+    explicit Value(List list) : data(std::move(list)) {}
+    explicit Value(Map map) : data(std::move(map)) {}
+
+    // 按 set 的写法解析：[a,b,c] 为列表，{k:v,...} 为映射（每项都有冒号且键不重复），规范写法的十进制整数为整数，
+    // 其余为字符串。解析结果展开后与 text 完全相同
+    static Value parse(std::string_view text);
+
+    Type type() const { return static_cast<Type>(data.index()); }
+
+    // 对应类型的值本身，类型不符时返回 nullptr
+    const std::string* string() const { return std::get_if<std::string>(&data); }
+    const List* list() const { return std::get_if<List>(&data); }
+    const Map* map() const { return std::get_if<Map>(&data); }
+
+    // 整数值；字符串的内容为十进制整数时也可以取得
+    bool as_integer(int64_t& number) const;
+
+    // 列表按下标、映射按键取元素，不存在时返回 nullptr
+    const std::string* element(std::string_view key) const;
+
+    // 展开为文本追加到 out
+    void append_to(std::string& out) const;
+    std::string to_string() const;
+
+    bool operator==(const Value& other) const { return data == other.data; }
+    bool operator!=(const Value& other) const { return data != other.data; }
+
+private:
+    std::variant<std::string, int64_t, List, Map> data; // 顺序与 Type 一致
+};
+
+/**
+ * @brief shell 变量表
+ *
+ * 变量名第一次出现时驻留为符号，符号就是值槽数组的下标：预先解析的表达式保存符号，
+ * 之后每次取值只是一次数组访问，不再对名字求哈希。按名字查找时驻留表以 string_view 为键，
+ * 不需要构造临时字符串。
+ *
+ * 插件接口中的 PluginContext::global_vars 仍指向 unordered_map<string, string>（shell_global_vars），
+ * 作为兼容视图：每次修改同时写入值的文本形式。插件可能直接修改视图，执行插件代码之后调用 sync_from_view() 读回。
+ */
+class VariableStore {
+public:
+    using Symbol = uint32_t;
+
+    // 名字对应的符号，第一次出现时分配
+    static Symbol intern(std::string_view name);
+    static const std::string& name(Symbol symbol);
+
+    // 变量的值，未设置时返回 nullptr
+    static const Value* get(Symbol symbol);
+    static const Value* get(std::string_view name);
+
+    static void set(Symbol symbol, Value value);
+    static void set(std::string_view name, Value value);
+    static void unset(Symbol symbol);
+
+    // 读回插件对兼容视图的修改：内容变化的变量改为字符串值，被删除的变量取消设置
+    static void sync_from_view();
+};
+
+#endif // VARIABLE_STORE_H
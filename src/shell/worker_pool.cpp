@@ -0,0 +1,69 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+
+size_t WorkerPool::default_worker_count() {
+    // 文件操作主要受 I/O 限制，线程过多只会增加竞争
+    size_t hw = std::thread::hardware_concurrency();
+    if (hw == 0) hw = 2;
+    return std::min<size_t>(std::max<size_t>(hw, 2), 8);
+}
+
+WorkerPool::WorkerPool(size_t worker_count, size_t queue_limit) {
+    if (worker_count == 0) worker_count = default_worker_count();
+    this->queue_limit = queue_limit == 0 ? worker_count * 4 : queue_limit;
+
+    workers.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    task_ready.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+    std::unique_lock<std::mutex> lock(mutex);
+    slot_free.wait(lock, [this]() { return tasks.size() < queue_limit; });
+    tasks.push_back(std::move(task));
+    lock.unlock();
+    task_ready.notify_one();
+}
+
+void WorkerPool::wait_idle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    all_done.wait(lock, [this]() { return tasks.empty() && active == 0; });
+}
+
+void WorkerPool::worker_loop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            task_ready.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return; // stopping 且队列已清空
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            active++;
+        }
+        slot_free.notify_one();
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active--;
+            if (tasks.empty() && active == 0) {
+                all_done.notify_all();
+            }
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 有界工作线程池，用于并行处理大量小任务（复制、删除等）
+ *
+ * 队列满时 submit() 会阻塞调用者，避免遍历大目录树时任务无限堆积。
+ * 任务内部不应再向同一个线程池提交任务，否则队列满时可能死锁。
+ */
+class WorkerPool {
+public:
+    /**
+     * @param worker_count 工作线程数量，0 表示根据 CPU 核心数自动选择
+     * @param queue_limit 等待队列上限，0 表示工作线程数量的 4 倍
+     */
+    explicit WorkerPool(size_t worker_count = 0, size_t queue_limit = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // 等待所有已提交的任务执行完毕
+    void wait_idle();
+
+    size_t size() const { return workers.size(); }
+
+    static size_t default_worker_count();
+
+private:
+    void worker_loop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable task_ready;
+    std::condition_variable slot_free;
+    std::condition_variable all_done;
+    size_t queue_limit;
+    size_t active = 0;
+    bool stopping = false;
+};
+
+#endif // WORKER_POOL_H